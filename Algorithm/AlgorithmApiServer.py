@@ -55,6 +55,103 @@ def imageObjectDetect():
     return json.dumps(data,ensure_ascii=False)
 
 
+@app.route("/image/objectDetectBinary",methods=['POST'])
+def imageObjectDetectBinary():
+    """
+    请求体为jpg图片的二进制数据，参数放在请求头 X-App-Key、X-Algorithm 中
+    返回紧凑的文本格式，每行以逗号分隔：
+        第一行 code,msg
+        其余每行一个目标 x1,y1,x2,y2,score,class_name
+    """
+    algorithm_str = request.headers.get("X-Algorithm")
+    appKey = request.headers.get("X-App-Key")
+    encoded_image_byte = request.get_data()
+
+    code = 0
+    msg = "unknown error"
+    lines = []
+
+    if encoded_image_byte:
+        if algorithm_str in ["openvino_yolov5"]:
+
+            image_array = np.frombuffer(encoded_image_byte, np.uint8)
+            image = cv2.imdecode(image_array, cv2.IMREAD_COLOR) # opencv 解码
+
+            if image is None:
+                msg = "image decode error"
+            else:
+                if "openvino_yolov5" == algorithm_str:
+                    detect_num, detect_data = openVinoYoloV5Detector.detect(image)
+                    for d in detect_data:
+                        loc = d["location"]
+                        lines.append("%d,%d,%d,%d,%.4f,%s" % (loc["x1"], loc["y1"], loc["x2"], loc["y2"],
+                                                               d["score"], d["class_name"]))
+
+                code = 1000
+                msg = "success"
+        else:
+            msg = "algorithm=%s not supported"%algorithm_str
+    else:
+        msg = "image not uploaded"
+
+    body = "\n".join(["%d,%s" % (code, msg)] + lines)
+    return app.response_class(body, mimetype="text/plain")
+
+
+@app.route("/image/objectDetectBatch",methods=['POST'])
+def imageObjectDetectBatch():
+    """
+    请求体为多张jpg图片的二进制数据依次拼接，每张图片的字节数放在请求头 X-Image-Sizes 中（逗号分隔）
+    返回紧凑的文本格式，每行以逗号分隔：
+        第一行 code,msg
+        其余每行一个目标 index,x1,y1,x2,y2,score,class_name（index为图片在请求中的序号）
+    """
+    algorithm_str = request.headers.get("X-Algorithm")
+    appKey = request.headers.get("X-App-Key")
+    image_sizes = request.headers.get("X-Image-Sizes", "")
+    encoded_images_byte = request.get_data()
+
+    code = 0
+    msg = "unknown error"
+    lines = []
+
+    try:
+        sizes = [int(size) for size in image_sizes.split(",") if size]
+    except ValueError:
+        sizes = []
+
+    if not sizes or sum(sizes) != len(encoded_images_byte):
+        msg = "image sizes error"
+    elif algorithm_str not in ["openvino_yolov5"]:
+        msg = "algorithm=%s not supported"%algorithm_str
+    else:
+        images = []
+        offset = 0
+        for size in sizes:
+            image_array = np.frombuffer(encoded_images_byte, np.uint8, count=size, offset=offset)
+            images.append(cv2.imdecode(image_array, cv2.IMREAD_COLOR))
+            offset += size
+
+        if any(image is None for image in images):
+            msg = "image decode error"
+        else:
+            if hasattr(openVinoYoloV5Detector, "detect_batch"):
+                results = openVinoYoloV5Detector.detect_batch(images)
+            else:
+                results = [openVinoYoloV5Detector.detect(image) for image in images]
+
+            for index, (detect_num, detect_data) in enumerate(results):
+                for d in detect_data:
+                    loc = d["location"]
+                    lines.append("%d,%d,%d,%d,%d,%.4f,%s" % (index, loc["x1"], loc["y1"], loc["x2"], loc["y2"],
+                                                               d["score"], d["class_name"]))
+            code = 1000
+            msg = "success"
+
+    body = "\n".join(["%d,%s" % (code, msg)] + lines)
+    return app.response_class(body, mimetype="text/plain")
+
+
 if __name__ == "__main__":
 
     parse = argparse.ArgumentParser()
@@ -32,6 +32,25 @@ def objectDetect(filename):
     # cv2.imshow('image', image)
     # cv2.waitKey(0)
     # cv2.destroyAllWindows()
+
+def objectDetectBinary(filename):
+    t1 = time.time()
+    image = cv2.imread(filename)
+
+    encoded_image_byte = cv2.imencode(".jpg", image)[1].tobytes()  # bytes类型
+
+    url = '%s/image/objectDetectBinary'%backend_host
+    headers = {
+        "Content-Type": "application/octet-stream",
+        "X-App-Key": appKey,
+        "X-Algorithm": "openvino_yolov5",
+    }
+
+    res=requests.post(url,data=encoded_image_byte,headers=headers)
+    t2 = time.time()
+    t = "spend %.5f 秒"%(t2 - t1)
+    print(t,res.status_code,res.text)
+
 if __name__ == '__main__':
 
     appKey = "s84dsd#7hf34r3jsk@fs$d#$dd"
@@ -42,6 +61,7 @@ if __name__ == '__main__':
 
 
     objectDetect(filename)
+    objectDetectBinary(filename)
 
 
 
@@ -0,0 +1,129 @@
+﻿#include "AlarmImagePool.h"
+#include "GenerateAlarm.h"
+#include "Utils/Log.h"
+
+namespace AVSAnalyzer {
+    static const int ALARM_IMAGE_MIN_CLASS_SIZE = 16 * 1024;// 最小级别16KB
+    static const int ALARM_IMAGE_CLASS_NUM = 12;            // 最大级别32MB
+
+    AlarmImagePool::AlarmImagePool(int64_t budgetBytes) :
+        mBudgetBytes(budgetBytes > 0 ? budgetBytes : 0),
+        mFreeImages(ALARM_IMAGE_CLASS_NUM)
+    {
+        LOGI("budgetBytes=%lld", mBudgetBytes);
+    }
+
+    AlarmImagePool::~AlarmImagePool()
+    {
+        mFreeImages_mtx.lock();
+        if (mUsingBytes > 0) {
+            LOGE("mUsingBytes=%lld, images are still in use", mUsingBytes);
+        }
+        for (size_t i = 0; i < mFreeImages.size(); i++)
+        {
+            for (auto image : mFreeImages[i]) {
+                delete image;
+            }
+            mFreeImages[i].clear();
+        }
+        mFreeImages_mtx.unlock();
+
+        LOGI("hits=%lld,misses=%lld,evictCount=%lld,rejectCount=%lld", mHits, mMisses, mEvictCount, mRejectCount);
+    }
+
+    int AlarmImagePool::getSizeClass(int size) {
+        int classSize = ALARM_IMAGE_MIN_CLASS_SIZE;
+        for (int i = 0; i < ALARM_IMAGE_CLASS_NUM; i++)
+        {
+            if (size <= classSize) {
+                return i;
+            }
+            classSize *= 2;
+        }
+        return -1;
+    }
+
+    AVSAlarmImage* AlarmImagePool::gain(int size) {
+        int sizeClass = getSizeClass(size);
+        if (sizeClass < 0) {
+            LOGE("size=%d is too large", size);
+            return nullptr;
+        }
+        int classSize = ALARM_IMAGE_MIN_CLASS_SIZE << sizeClass;
+
+        AVSAlarmImage* image = nullptr;
+        std::vector<AVSAlarmImage*> evictImages;// 在锁外释放
+
+        mFreeImages_mtx.lock();
+        if (!mFreeImages[sizeClass].empty()) {
+            image = mFreeImages[sizeClass].back();
+            mFreeImages[sizeClass].pop_back();
+            mUsingBytes += classSize;
+            mHits++;
+            mFreeImages_mtx.unlock();
+            return image;
+        }
+
+        // 超出预算时从最大的级别开始释放空闲图片
+        for (int i = ALARM_IMAGE_CLASS_NUM - 1; i >= 0 && mBudgetBytes > 0 && mAllocatedBytes + classSize > mBudgetBytes; i--)
+        {
+            while (!mFreeImages[i].empty() && mAllocatedBytes + classSize > mBudgetBytes) {
+                evictImages.push_back(mFreeImages[i].back());
+                mFreeImages[i].pop_back();
+                mAllocatedBytes -= ALARM_IMAGE_MIN_CLASS_SIZE << i;
+                mInstanceCount--;
+                mEvictCount++;
+            }
+        }
+
+        bool reject = mBudgetBytes > 0 && mAllocatedBytes + classSize > mBudgetBytes;
+        if (reject) {
+            mRejectCount++;
+        }
+        else {
+            mAllocatedBytes += classSize;
+            mUsingBytes += classSize;
+            mInstanceCount++;
+            mMisses++;
+        }
+        mFreeImages_mtx.unlock();
+
+        for (auto evictImage : evictImages) {
+            delete evictImage;
+        }
+        if (!reject) {
+            image = AVSAlarmImage::Create(classSize);
+        }
+        return image;
+    }
+
+    void AlarmImagePool::giveBack(AVSAlarmImage* image) {
+        int sizeClass = getSizeClass(image->getCapacity());
+
+        mFreeImages_mtx.lock();
+        mUsingBytes -= image->getCapacity();
+        image->happen = false;
+        image->happenScore = 0;
+        mFreeImages[sizeClass].push_back(image);
+        mFreeImages_mtx.unlock();
+    }
+
+    int64_t AlarmImagePool::getUsingBytes() {
+        std::unique_lock<std::mutex> lck(mFreeImages_mtx);
+        return mUsingBytes;
+    }
+
+    void AlarmImagePool::getStats(int64_t& budgetBytes, int64_t& allocatedBytes, int64_t& usingBytes, int& instanceCount,
+        int64_t& hits, int64_t& misses, int64_t& evictCount, int64_t& rejectCount) {
+        mFreeImages_mtx.lock();
+        budgetBytes = mBudgetBytes;
+        allocatedBytes = mAllocatedBytes;
+        usingBytes = mUsingBytes;
+        instanceCount = mInstanceCount;
+        hits = mHits;
+        misses = mMisses;
+        evictCount = mEvictCount;
+        rejectCount = mRejectCount;
+        mFreeImages_mtx.unlock();
+    }
+}
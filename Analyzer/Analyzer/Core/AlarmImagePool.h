@@ -0,0 +1,38 @@
+﻿#ifndef ANALYZER_ALARMIMAGEPOOL_H
+#define ANALYZER_ALARMIMAGEPOOL_H
+#include <vector>
+#include <mutex>
+namespace AVSAnalyzer {
+	struct AVSAlarmImage;
+
+	// 所有布控共享的压缩图片池，按压缩后的实际大小分级（16KB起每级翻倍）分配内存
+	// 已分配的内存（使用中 + 空闲）超过预算时先释放其他级别的空闲图片，仍然不够时拒绝分配
+	class AlarmImagePool
+	{
+	public:
+		explicit AlarmImagePool(int64_t budgetBytes);// budgetBytes为0表示不限制
+		~AlarmImagePool();
+	public:
+		AVSAlarmImage* gain(int size);// 获取容量不小于size的图片，超出内存预算时返回nullptr
+		void giveBack(AVSAlarmImage* image);
+		int64_t getUsingBytes();
+
+		void getStats(int64_t& budgetBytes, int64_t& allocatedBytes, int64_t& usingBytes, int& instanceCount,
+			int64_t& hits, int64_t& misses, int64_t& evictCount, int64_t& rejectCount);
+	private:
+		static int getSizeClass(int size);// size超过最大级别时返回-1
+
+		int64_t mBudgetBytes;
+
+		std::vector<std::vector<AVSAlarmImage*>> mFreeImages;// 按大小级别分组的空闲图片
+		std::mutex mFreeImages_mtx;
+		int64_t mAllocatedBytes = 0;// 已分配的内存（使用中 + 空闲）
+		int64_t mUsingBytes = 0;    // 使用中的内存
+		int     mInstanceCount = 0; // 已分配的图片数
+		int64_t mHits = 0;          // 从空闲图片中获取的次数
+		int64_t mMisses = 0;        // 需要新分配内存的次数
+		int64_t mEvictCount = 0;    // 为满足预算释放的空闲图片数
+		int64_t mRejectCount = 0;   // 超出预算拒绝分配的次数
+	};
+}
+#endif //ANALYZER_ALARMIMAGEPOOL_H
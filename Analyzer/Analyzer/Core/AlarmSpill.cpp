@@ -0,0 +1,394 @@
+﻿#include "AlarmSpill.h"
+#include "GenerateAlarm.h"
+#include "Utils/Log.h"
+#include "Utils/Common.h"
+#include <string.h>
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+namespace AVSAnalyzer {
+    static const uint32_t ALARM_SPILL_MAGIC = 0x41535641;// "AVSA"
+    static const uint32_t ALARM_SPILL_PENDING = 0;       // 待生成
+    static const uint32_t ALARM_SPILL_DONE = 1;          // 已生成或已丢弃
+
+    // 分段中每个报警记录的头部，之后是imageCount个图片（AlarmSpillImageHeader + 数据，按8字节对齐）
+    struct AlarmSpillHeader
+    {
+        uint32_t magic;
+        uint32_t state;
+        int64_t  totalSize;// 包含头部的记录长度
+        int64_t  happen;
+        int32_t  width;
+        int32_t  height;
+        int32_t  fps;
+        int32_t  imageCount;
+        char     controlCode[64];
+    };
+    struct AlarmSpillImageHeader
+    {
+        int32_t size;
+        int32_t width;
+        int32_t height;
+        int32_t channels;
+    };
+
+    struct AlarmSpillSegment
+    {
+        int index = 0;
+        std::string path;
+        unsigned char* data = nullptr;// 映射的内存
+        int64_t size = 0;
+        int64_t writeOffset = 0;
+        int     pendingCount = 0;     // 分段中未生成的报警数
+#ifdef WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        int fd = -1;
+#endif
+    };
+
+    static int64_t alignSize(int64_t size) {
+        return (size + 7) & ~((int64_t)7);
+    }
+
+    AlarmSpill::AlarmSpill(const std::string& dir, int64_t segmentBytes, int64_t maxBytes) :
+        mDir(dir),
+        mSegmentBytes(segmentBytes),
+        mMaxBytes(maxBytes)
+    {
+#ifdef WIN32
+        _mkdir(mDir.data());
+#else
+        mkdir(mDir.data(), 0755);
+#endif
+        LOGI("dir=%s,segmentBytes=%lld,maxBytes=%lld", mDir.data(), mSegmentBytes, mMaxBytes);
+    }
+
+    AlarmSpill::~AlarmSpill()
+    {
+        std::unique_lock<std::mutex> lck(mSegments_mtx);
+        for (auto it = mSegments.begin(); it != mSegments.end(); ++it)
+        {
+            closeSegment(it->second, it->second->pendingCount == 0);
+        }
+        mSegments.clear();
+        mActiveSegment = nullptr;
+    }
+
+    std::string AlarmSpill::getSegmentPath(int index) {
+        char name[64];
+        snprintf(name, sizeof(name), "/alarm-%08d.spill", index);
+        return mDir + name;
+    }
+
+    AlarmSpillSegment* AlarmSpill::openSegment(int index, int64_t size, bool create) {
+        AlarmSpillSegment* segment = new AlarmSpillSegment;
+        segment->index = index;
+        segment->path = getSegmentPath(index);
+
+#ifdef WIN32
+        segment->file = CreateFileA(segment->path.data(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+            create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (INVALID_HANDLE_VALUE == segment->file) {
+            LOGE("CreateFileA error: %s", segment->path.data());
+            delete segment;
+            return nullptr;
+        }
+        if (!create) {
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(segment->file, &fileSize);
+            size = fileSize.QuadPart;
+        }
+        // 映射的长度超过文件长度时文件自动扩展
+        segment->mapping = CreateFileMappingA(segment->file, NULL, PAGE_READWRITE,
+            (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+        if (segment->mapping) {
+            segment->data = (unsigned char*)MapViewOfFile(segment->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+        }
+#else
+        segment->fd = open(segment->path.data(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+        if (segment->fd < 0) {
+            LOGE("open error: %s", segment->path.data());
+            delete segment;
+            return nullptr;
+        }
+        if (create) {
+            if (ftruncate(segment->fd, size) != 0) {
+                LOGE("ftruncate error: %s", segment->path.data());
+            }
+        }
+        else {
+            struct stat st;
+            fstat(segment->fd, &st);
+            size = st.st_size;
+        }
+        if (size > 0) {
+            void* data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+            if (MAP_FAILED != data) {
+                segment->data = (unsigned char*)data;
+            }
+        }
+#endif
+        if (!segment->data) {
+            LOGE("map segment error: %s", segment->path.data());
+            closeSegment(segment, create);
+            return nullptr;
+        }
+        segment->size = size;
+        mMappedBytes += size;
+        return segment;
+    }
+
+    void AlarmSpill::closeSegment(AlarmSpillSegment* segment, bool remove) {
+#ifdef WIN32
+        if (segment->data) {
+            UnmapViewOfFile(segment->data);
+        }
+        if (segment->mapping) {
+            CloseHandle(segment->mapping);
+        }
+        if (INVALID_HANDLE_VALUE != segment->file) {
+            CloseHandle(segment->file);
+        }
+#else
+        if (segment->data) {
+            munmap(segment->data, (size_t)segment->size);
+        }
+        if (segment->fd >= 0) {
+            close(segment->fd);
+        }
+#endif
+        if (segment->data) {
+            mMappedBytes -= segment->size;
+        }
+        if (remove) {
+            removeFile(segment->path);
+        }
+        delete segment;
+    }
+
+    bool AlarmSpill::spill(AVSAlarm* alarm) {
+        int64_t totalSize = alignSize(sizeof(AlarmSpillHeader));
+        for (size_t i = 0; i < alarm->images.size(); i++)
+        {
+            totalSize += sizeof(AlarmSpillImageHeader) + alignSize(alarm->images[i]->getSize());
+        }
+
+        std::unique_lock<std::mutex> lck(mSegments_mtx);
+        if (totalSize > mSegmentBytes) {
+            mFailCount++;
+            return false;
+        }
+
+        AlarmSpillSegment* segment = mActiveSegment;
+        if (!segment || segment->writeOffset + totalSize > segment->size) {
+            // 当前分段已满，新建分段；超出磁盘上限时不落盘，报警仍然保留在内存中
+            if (mMaxBytes > 0 && (int64_t)(mSegments.size() + 1) * mSegmentBytes > mMaxBytes) {
+                mFailCount++;
+                return false;
+            }
+            segment = openSegment(mNextIndex, mSegmentBytes, true);
+            if (!segment) {
+                mFailCount++;
+                return false;
+            }
+            mNextIndex++;
+            if (mActiveSegment && 0 == mActiveSegment->pendingCount) {
+                mSegments.erase(mActiveSegment->index);
+                closeSegment(mActiveSegment, true);
+            }
+            mSegments[segment->index] = segment;
+            mActiveSegment = segment;
+        }
+
+        int64_t offset = segment->writeOffset;
+        unsigned char* p = segment->data + offset + alignSize(sizeof(AlarmSpillHeader));
+        alarm->spillImages.clear();
+        alarm->spillImages.reserve(alarm->images.size());
+        for (size_t i = 0; i < alarm->images.size(); i++)
+        {
+            AVSAlarmImage* image = alarm->images[i];
+            AlarmSpillImageHeader imageHeader;
+            imageHeader.size = image->getSize();
+            imageHeader.width = image->getWidth();
+            imageHeader.height = image->getHeight();
+            imageHeader.channels = image->getChannels();
+            memcpy(p, &imageHeader, sizeof(imageHeader));
+            p += sizeof(imageHeader);
+            memcpy(p, image->getData(), imageHeader.size);
+
+            AVSAlarmSpillImage spillImage;
+            spillImage.data = p;
+            spillImage.size = imageHeader.size;
+            spillImage.width = imageHeader.width;
+            spillImage.height = imageHeader.height;
+            spillImage.channels = imageHeader.channels;
+            alarm->spillImages.push_back(spillImage);
+            p += alignSize(imageHeader.size);
+        }
+
+        // 头部最后写入，写入中途退出时该记录不会被恢复
+        AlarmSpillHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = ALARM_SPILL_MAGIC;
+        header.state = ALARM_SPILL_PENDING;
+        header.totalSize = totalSize;
+        header.happen = alarm->happen;
+        header.width = alarm->width;
+        header.height = alarm->height;
+        header.fps = alarm->fps;
+        header.imageCount = (int32_t)alarm->images.size();
+        strncpy(header.controlCode, alarm->controlCode.data(), sizeof(header.controlCode) - 1);
+        memcpy(segment->data + offset, &header, sizeof(header));
+
+        segment->writeOffset += totalSize;
+        segment->pendingCount++;
+        alarm->spillSegment = segment;
+        alarm->spillOffset = offset;
+        mSpillCount++;
+        return true;
+    }
+
+    void AlarmSpill::release(AVSAlarm* alarm) {
+        AlarmSpillSegment* segment = alarm->spillSegment;
+        if (!segment) {
+            return;
+        }
+        alarm->spillSegment = nullptr;
+        alarm->spillImages.clear();
+
+        std::unique_lock<std::mutex> lck(mSegments_mtx);
+        AlarmSpillHeader* header = (AlarmSpillHeader*)(segment->data + alarm->spillOffset);
+        header->state = ALARM_SPILL_DONE;
+        segment->pendingCount--;
+        if (segment->pendingCount <= 0 && segment != mActiveSegment) {
+            mSegments.erase(segment->index);
+            closeSegment(segment, true);
+        }
+    }
+
+    void AlarmSpill::recover(std::vector<AVSAlarm*>& alarms) {
+        std::vector<int> indexes;
+#ifdef WIN32
+        WIN32_FIND_DATAA findData;
+        HANDLE find = FindFirstFileA((mDir + "/alarm-*.spill").data(), &findData);
+        if (INVALID_HANDLE_VALUE != find) {
+            do {
+                int index = -1;
+                if (1 == sscanf(findData.cFileName, "alarm-%d.spill", &index) && index >= 0) {
+                    indexes.push_back(index);
+                }
+            } while (FindNextFileA(find, &findData));
+            FindClose(find);
+        }
+#else
+        DIR* dir = opendir(mDir.data());
+        if (dir) {
+            struct dirent* entry;
+            while ((entry = readdir(dir)) != NULL) {
+                int index = -1;
+                if (1 == sscanf(entry->d_name, "alarm-%d.spill", &index) && index >= 0) {
+                    indexes.push_back(index);
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        std::sort(indexes.begin(), indexes.end());
+
+        std::unique_lock<std::mutex> lck(mSegments_mtx);
+        for (size_t i = 0; i < indexes.size(); i++)
+        {
+            mNextIndex = std::max(mNextIndex, indexes[i] + 1);
+            AlarmSpillSegment* segment = openSegment(indexes[i], 0, false);
+            if (!segment) {
+                continue;
+            }
+
+            int64_t offset = 0;
+            while (offset + (int64_t)sizeof(AlarmSpillHeader) <= segment->size) {
+                AlarmSpillHeader* header = (AlarmSpillHeader*)(segment->data + offset);
+                if (ALARM_SPILL_MAGIC != header->magic || header->totalSize <= 0 ||
+                    offset + header->totalSize > segment->size) {
+                    break;
+                }
+                if (ALARM_SPILL_PENDING == header->state) {
+                    // 崩溃时可能只有头部落盘，图片头部和数据都必须在记录范围内
+                    int64_t end = offset + header->totalSize;
+                    int64_t pos = offset + alignSize(sizeof(AlarmSpillHeader));
+                    bool valid = header->imageCount >= 0 && pos <= end;
+                    std::vector<AVSAlarmSpillImage> spillImages;
+                    for (int j = 0; valid && j < header->imageCount; j++)
+                    {
+                        if (pos + (int64_t)sizeof(AlarmSpillImageHeader) > end) {
+                            valid = false;
+                            break;
+                        }
+                        AlarmSpillImageHeader imageHeader;
+                        memcpy(&imageHeader, segment->data + pos, sizeof(imageHeader));
+                        pos += sizeof(imageHeader);
+                        if (imageHeader.size < 0 || pos + alignSize(imageHeader.size) > end) {
+                            valid = false;
+                            break;
+                        }
+
+                        AVSAlarmSpillImage spillImage;
+                        spillImage.data = segment->data + pos;
+                        spillImage.size = imageHeader.size;
+                        spillImage.width = imageHeader.width;
+                        spillImage.height = imageHeader.height;
+                        spillImage.channels = imageHeader.channels;
+                        spillImages.push_back(spillImage);
+                        pos += alignSize(imageHeader.size);
+                    }
+                    if (!valid) {
+                        LOGE("skip corrupt record: segment=%d,offset=%lld", segment->index, (long long)offset);
+                        header->state = ALARM_SPILL_DONE;
+                        offset += header->totalSize;
+                        continue;
+                    }
+
+                    header->controlCode[sizeof(header->controlCode) - 1] = '\0';
+                    AVSAlarm* alarm = AVSAlarm::Create(header->height, header->width, header->fps,
+                        header->happen, header->controlCode);
+                    alarm->spillImages = spillImages;
+                    alarm->spillSegment = segment;
+                    alarm->spillOffset = offset;
+                    segment->pendingCount++;
+                    alarms.push_back(alarm);
+                    mRecoverCount++;
+                }
+                offset += header->totalSize;
+            }
+            segment->writeOffset = segment->size;// 恢复的分段不再写入
+
+            if (0 == segment->pendingCount) {
+                closeSegment(segment, true);
+            }
+            else {
+                mSegments[segment->index] = segment;
+            }
+        }
+        LOGI("segmentCount=%d,recoverCount=%lld", (int)mSegments.size(), mRecoverCount);
+    }
+
+    void AlarmSpill::getStats(int& segmentCount, int64_t& mappedBytes, int64_t& spillCount, int64_t& failCount, int64_t& recoverCount) {
+        std::unique_lock<std::mutex> lck(mSegments_mtx);
+        segmentCount = mSegments.size();
+        mappedBytes = mMappedBytes;
+        spillCount = mSpillCount;
+        failCount = mFailCount;
+        recoverCount = mRecoverCount;
+    }
+}
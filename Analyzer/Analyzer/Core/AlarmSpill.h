@@ -0,0 +1,42 @@
+﻿#ifndef ANALYZER_ALARMSPILL_H
+#define ANALYZER_ALARMSPILL_H
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+namespace AVSAnalyzer {
+	struct AVSAlarm;
+	struct AlarmSpillSegment;
+
+	// 待生成报警的落盘缓存：报警的图片追加写入内存映射的分段文件，图片内存立即归还图片池
+	// 每个报警连续写在一个分段中，分段中的报警全部生成后删除该分段，重启后恢复未生成的报警
+	class AlarmSpill
+	{
+	public:
+		AlarmSpill(const std::string& dir, int64_t segmentBytes, int64_t maxBytes);
+		~AlarmSpill();// 只关闭分段，不删除仍有未生成报警的分段文件
+	public:
+		bool spill(AVSAlarm* alarm);   // 写入报警的所有图片，成功后alarm->spillImages指向映射内存，images由调用者归还
+		void release(AVSAlarm* alarm); // 报警已生成或被丢弃，分段中的报警全部完成后删除该分段
+		void recover(std::vector<AVSAlarm*>& alarms);// 恢复上次运行未生成的报警，启动时调用一次
+		void getStats(int& segmentCount, int64_t& mappedBytes, int64_t& spillCount, int64_t& failCount, int64_t& recoverCount);
+	private:
+		AlarmSpillSegment* openSegment(int index, int64_t size, bool create);
+		void closeSegment(AlarmSpillSegment* segment, bool remove);
+		std::string getSegmentPath(int index);
+
+		std::string mDir;
+		int64_t mSegmentBytes;
+		int64_t mMaxBytes;
+
+		std::map<int, AlarmSpillSegment*> mSegments;// <分段序号,分段>
+		AlarmSpillSegment* mActiveSegment = nullptr;// 当前追加写入的分段
+		int mNextIndex = 0;
+		int64_t mMappedBytes = 0;
+		int64_t mSpillCount = 0;
+		int64_t mFailCount = 0;
+		int64_t mRecoverCount = 0;
+		std::mutex mSegments_mtx;
+	};
+}
+#endif //ANALYZER_ALARMSPILL_H
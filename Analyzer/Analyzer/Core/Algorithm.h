@@ -0,0 +1,50 @@
+﻿#ifndef ANALYZER_ALGORITHM_H
+#define ANALYZER_ALGORITHM_H
+
+#include <string>
+#include <vector>
+#include "VideoFrame.h"
+
+namespace AVSAnalyzer {
+
+	struct AlgorithmDetectObject
+	{
+		int x1;
+		int y1;
+		int x2;
+		int y2;
+		float score;
+		std::string class_name;
+	};
+
+	/*
+	目标检测算法接口，Analyzer只依赖这个接口
+	AlgorithmWithApi：通过http调用算法服务
+	AlgorithmWithOnnx：进程内通过OpenCV DNN在CPU上运行onnx模型
+	实现类需要保证objectDetect可以被多个检测线程同时调用
+	*/
+	class Algorithm
+	{
+	public:
+		virtual ~Algorithm() {}
+	public:
+		virtual bool test() = 0;
+		virtual bool objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects) = 0;
+
+		// 是否支持多帧合并为一次检测，不支持时InferenceExecutor逐帧调用objectDetect
+		virtual bool isBatchable() { return false; }
+		// 多帧（可以来自不同布控）合并为一次检测，detects与frames一一对应
+		virtual bool objectDetectBatch(const std::vector<VideoFramePtr>& frames, std::vector<std::vector<AlgorithmDetectObject>>& detects) {
+			detects.clear();
+			detects.resize(frames.size());
+			bool result = true;
+			for (int i = 0; i < frames.size(); i++) {
+				if (!objectDetect(frames[i]->height, frames[i]->width, frames[i]->data, detects[i])) {
+					result = false;
+				}
+			}
+			return result;
+		}
+	};
+}
+#endif //ANALYZER_ALGORITHM_H
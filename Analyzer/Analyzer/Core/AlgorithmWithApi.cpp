@@ -0,0 +1,369 @@
+﻿#include "AlgorithmWithApi.h"
+#include <json/json.h>
+#include "Utils/Request.h"
+#include "Utils/HostBalancer.h"
+#include "Utils/Log.h"
+#include "Utils/Common.h"
+#include "Utils/Base64.h"
+#include "Config.h"
+
+#if defined(WIN32) && !defined(_DEBUG)
+#include <turbojpeg.h>
+#else
+#include <opencv2/opencv.hpp>
+#endif
+
+namespace AVSAnalyzer {
+
+    static bool analy_turboJpeg_compress(int height, int width, int channels, unsigned char* bgr, unsigned char*& out_data, unsigned long* out_size) {
+#ifdef WIN32
+#ifndef _DEBUG
+
+        tjhandle handle = tjInitCompress();
+        if (nullptr == handle) {
+            return false;
+        }
+
+        //pixel_format : TJPF::TJPF_BGR or other
+        const int JPEG_QUALITY = 75;
+        int pixel_format = TJPF::TJPF_BGR;
+        int pitch = tjPixelSize[pixel_format] * width;
+        int ret = tjCompress2(handle, bgr, width, pitch, height, pixel_format,
+            &out_data, out_size, TJSAMP_444, JPEG_QUALITY, TJFLAG_FASTDCT);
+
+        tjDestroy(handle);
+
+        if (ret != 0) {
+            return false;
+        }
+        return true;
+#endif // !_DEBUG
+#endif
+
+        return false;
+    }
+
+    static bool analy_compressBgr(int height, int width, int channels, unsigned char* bgr, std::vector<unsigned char>& out_jpeg) {
+
+#if defined(WIN32) && !defined(_DEBUG)
+        unsigned char* jpeg_data = nullptr;
+        unsigned long  jpeg_size = 0;
+
+        analy_turboJpeg_compress(height, width, channels, bgr, jpeg_data, &jpeg_size);
+
+        if (jpeg_size > 0 && jpeg_data != nullptr) {
+
+            out_jpeg.assign(jpeg_data, jpeg_data + jpeg_size);
+
+            free(jpeg_data);
+            jpeg_data = nullptr;
+
+            return true;
+        }
+        else {
+            return false;
+        }
+
+
+#else
+        cv::Mat bgr_image(height, width, CV_8UC3, bgr);
+
+        std::vector<int> quality = { 100 };
+        return cv::imencode(".jpg", bgr_image, out_jpeg, quality);
+
+
+#endif
+    }
+
+    static bool analy_compressBgrAndEncodeBase64(int height, int width, int channels, unsigned char* bgr, std::string& out_base64) {
+        std::vector<unsigned char> jpeg;
+        if (!analy_compressBgr(height, width, channels, bgr, jpeg)) {
+            return false;
+        }
+        Base64Encode(jpeg.data(), jpeg.size(), out_base64);
+        return true;
+    }
+
+    AlgorithmWithApi::AlgorithmWithApi(Config* config, RequestPool* requestPool, HostBalancer* hostBalancer) :
+        mConfig(config),
+        mRequestPool(requestPool),
+        mHostBalancer(hostBalancer)
+    {
+        LOGI("");
+    }
+
+    AlgorithmWithApi::~AlgorithmWithApi()
+    {
+        LOGI("");
+    }
+    bool AlgorithmWithApi::test() {
+        std::string response;
+        std::string host;
+        int hostIndex = mHostBalancer->select(host);
+        if (hostIndex < 0) {
+            LOGE("no algorithm api host");
+            return false;
+        }
+        std::string url = host + "/image/objectDetect";
+
+        int64_t t1 = getCurTime();
+        Request request(mRequestPool);
+        bool ret = request.get(url.data(), response);
+        mHostBalancer->report(hostIndex, ret, getCurTime() - t1);
+
+        //LOGI("ret=%d,response=%s",ret,response.data());
+        return ret;
+
+    }
+
+    bool AlgorithmWithApi::objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects) {
+        if (mConfig->algorithmApiTransport == "binary") {
+            return this->objectDetectBinary(height, width, bgr, detects);
+        }
+        int64_t t1 = getCurTime();
+        std::string imageBase64;
+        analy_compressBgrAndEncodeBase64(height, width, 3, bgr, imageBase64);
+        int64_t t2 = getCurTime();
+
+        std::string host;
+        int hostIndex = mHostBalancer->select(host);
+        if (hostIndex < 0) {
+            LOGE("no algorithm api host");
+            return false;
+        }
+        std::string url = host+"/image/objectDetect";
+
+        Json::Value param;
+        param["appKey"] = "s84dsd#7hf34r3jsk@fs$d#$dd";
+        param["algorithm"] = "openvino_yolov5";
+        param["image_base64"] = imageBase64;
+        Json::StreamWriterBuilder writerBuilder;
+        writerBuilder["indentation"] = "";// 不格式化，避免多余的空白字符
+        std::string data = Json::writeString(writerBuilder, param);
+        param = NULL;
+
+        int64_t t3 = getCurTime();
+        Request request(mRequestPool);
+        std::string response;
+        bool result = request.post(url.data(), data.data(), response);
+        int64_t t4 = getCurTime();
+        mHostBalancer->report(hostIndex, result, t4 - t3);
+
+        if (result) {
+            result = this->parseObjectDetect(response, detects);
+        }
+
+        //LOGI("serialize spend: %lld(ms),call api spend: %lld(ms)", (t2 - t1), (t4 - t3));
+
+        return result;
+    }
+    bool AlgorithmWithApi::objectDetectBinary(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects) {
+        int64_t t1 = getCurTime();
+        std::vector<unsigned char> jpeg;
+        if (!analy_compressBgr(height, width, 3, bgr, jpeg)) {
+            LOGE("compress bgr error");
+            return false;
+        }
+        int64_t t2 = getCurTime();
+
+        std::string host;
+        int hostIndex = mHostBalancer->select(host);
+        if (hostIndex < 0) {
+            LOGE("no algorithm api host");
+            return false;
+        }
+        std::string url = host + "/image/objectDetectBinary";
+
+        // 图片以二进制上传，其他参数放在请求头中
+        std::vector<std::string> headers;
+        headers.push_back("X-App-Key: s84dsd#7hf34r3jsk@fs$d#$dd");
+        headers.push_back("X-Algorithm: openvino_yolov5");
+
+        int64_t t3 = getCurTime();
+        Request request(mRequestPool);
+        std::string response;
+        bool result = request.postBinary(url.data(), jpeg.data(), jpeg.size(), headers, response);
+        int64_t t4 = getCurTime();
+        mHostBalancer->report(hostIndex, result, t4 - t3);
+
+        if (result) {
+            result = this->parseObjectDetectCompact(response, detects);
+        }
+
+        //LOGI("compress spend: %lld(ms),jpeg size: %d,call api spend: %lld(ms)", (t2 - t1), (int)jpeg.size(), (t4 - t3));
+
+        return result;
+    }
+    bool AlgorithmWithApi::isBatchable() {
+        return mConfig->algorithmBatchSize > 1 && mConfig->algorithmApiTransport == "binary";
+    }
+    bool AlgorithmWithApi::objectDetectBatch(const std::vector<VideoFramePtr>& frames, std::vector<std::vector<AlgorithmDetectObject>>& detects) {
+        // 所有图片依次拼接为请求体，每张图片的字节数放在请求头 X-Image-Sizes 中
+        std::vector<unsigned char> body;
+        std::vector<unsigned char> jpeg;
+        std::string imageSizes;
+        for (int i = 0; i < frames.size(); i++) {
+            jpeg.clear();
+            if (!analy_compressBgr(frames[i]->height, frames[i]->width, 3, frames[i]->data, jpeg)) {
+                LOGE("compress bgr error");
+                return false;
+            }
+            body.insert(body.end(), jpeg.begin(), jpeg.end());
+            if (i > 0) {
+                imageSizes += ",";
+            }
+            imageSizes += std::to_string(jpeg.size());
+        }
+
+        std::string host;
+        int hostIndex = mHostBalancer->select(host);
+        if (hostIndex < 0) {
+            LOGE("no algorithm api host");
+            return false;
+        }
+        std::string url = host + "/image/objectDetectBatch";
+
+        std::vector<std::string> headers;
+        headers.push_back("X-App-Key: s84dsd#7hf34r3jsk@fs$d#$dd");
+        headers.push_back("X-Algorithm: openvino_yolov5");
+        headers.push_back("X-Image-Sizes: " + imageSizes);
+
+        int64_t t1 = getCurTime();
+        Request request(mRequestPool);
+        std::string response;
+        bool result = request.postBinary(url.data(), body.data(), body.size(), headers, response);
+        mHostBalancer->report(hostIndex, result, getCurTime() - t1);
+
+        detects.clear();
+        detects.resize(frames.size());
+        if (result) {
+            result = this->parseObjectDetectBatchCompact(response, detects);
+        }
+        return result;
+    }
+    bool AlgorithmWithApi::parseObjectDetectBatchCompact(std::string& response, std::vector<std::vector<AlgorithmDetectObject>>& detects) {
+        /*
+        紧凑格式，每行以逗号分隔：
+        第一行 code,msg
+        其余每行一个目标 index,x1,y1,x2,y2,score,class_name（index为图片在请求中的序号）
+        */
+        size_t lineStart = 0;
+        size_t lineEnd = response.find('\n');
+        std::string line = response.substr(0, lineEnd);
+        int code = atoi(line.data());
+        if (code != 1000) {
+            LOGE("objectDetectBatch error: %s", line.data());
+            return false;
+        }
+
+        while (lineEnd != std::string::npos)
+        {
+            lineStart = lineEnd + 1;
+            lineEnd = response.find('\n', lineStart);
+            line = response.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+            if (line.empty()) {
+                continue;
+            }
+
+            int index = -1;
+            AlgorithmDetectObject object;
+            char class_name[128] = { 0 };
+            if (sscanf(line.data(), "%d,%d,%d,%d,%d,%f,%127[^\r\n]", &index,
+                &object.x1, &object.y1, &object.x2, &object.y2, &object.score, class_name) == 7 &&
+                index >= 0 && index < detects.size()) {
+                object.class_name = class_name;
+                detects[index].push_back(object);
+            }
+        }
+
+        return true;
+    }
+    bool AlgorithmWithApi::parseObjectDetectCompact(std::string& response, std::vector<AlgorithmDetectObject>& detects) {
+        /*
+        紧凑格式，每行以逗号分隔：
+        第一行 code,msg
+        其余每行一个目标 x1,y1,x2,y2,score,class_name
+        */
+        size_t lineStart = 0;
+        size_t lineEnd = response.find('\n');
+        std::string line = response.substr(0, lineEnd);
+        int code = atoi(line.data());
+        if (code != 1000) {
+            LOGE("objectDetectBinary error: %s", line.data());
+            return false;
+        }
+
+        while (lineEnd != std::string::npos)
+        {
+            lineStart = lineEnd + 1;
+            lineEnd = response.find('\n', lineStart);
+            line = response.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+            if (line.empty()) {
+                continue;
+            }
+
+            AlgorithmDetectObject object;
+            char class_name[128] = { 0 };
+            if (sscanf(line.data(), "%d,%d,%d,%d,%f,%127[^\r\n]",
+                &object.x1, &object.y1, &object.x2, &object.y2, &object.score, class_name) == 6) {
+                object.class_name = class_name;
+                detects.push_back(object);
+            }
+        }
+
+        return true;
+    }
+    bool AlgorithmWithApi::parseObjectDetect(std::string& response, std::vector<AlgorithmDetectObject>& detects) {
+
+        Json::CharReaderBuilder builder;
+        const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+
+        //Json::CharReaderBuilder b;
+        //Json::CharReader* reader(b.newCharReader());
+
+        Json::Value root;
+        JSONCPP_STRING errs;
+
+        bool result = false;
+
+        if (reader->parse(response.data(), response.data() + std::strlen(response.data()),
+            &root, &errs) && errs.empty()) {
+
+
+            if (root["code"].isInt()) {
+                int code = root["code"].asInt();
+                std::string msg = root["msg"].asString();
+
+                if (code == 1000) {
+                    Json::Value root_result = root["result"];
+                    int detect_num = root_result["detect_num"].asInt();
+                    Json::Value detect_data = root_result["detect_data"];
+
+                    for (auto i : detect_data) {
+                        AlgorithmDetectObject object;
+
+                        Json::Value loc = i["location"];
+                        object.x1 = loc["x1"].asInt();
+                        object.y1 = loc["y1"].asInt();
+                        object.x2 = loc["x2"].asInt();
+                        object.y2 = loc["y2"].asInt();
+                        object.score = i["score"].asFloat();
+                        object.class_name = i["class_name"].asString();
+
+                        detects.push_back(object);
+
+                    }
+                    result = true;
+                }
+            }
+
+
+        }
+
+        root = NULL;
+        //delete reader;
+        //reader = NULL;
+
+        return result;
+    }
+}
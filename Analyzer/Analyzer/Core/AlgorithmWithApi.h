@@ -0,0 +1,32 @@
+﻿#ifndef ANALYZER_ALGORITHMWITHAPI_H
+#define ANALYZER_ALGORITHMWITHAPI_H
+
+#include "Algorithm.h"
+
+namespace AVSAnalyzer {
+	class Config;
+	class RequestPool;
+	class HostBalancer;
+
+	class AlgorithmWithApi : public Algorithm
+	{
+	public:
+		AlgorithmWithApi() = delete;
+		AlgorithmWithApi(Config* config, RequestPool* requestPool, HostBalancer* hostBalancer);
+		virtual ~AlgorithmWithApi();
+	public:
+		virtual bool test();
+		virtual bool objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects);
+		virtual bool isBatchable();// 二进制传输且algorithmBatchSize大于1时支持
+		virtual bool objectDetectBatch(const std::vector<VideoFramePtr>& frames, std::vector<std::vector<AlgorithmDetectObject>>& detects);
+	private:
+		bool objectDetectBinary(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects);
+		bool parseObjectDetect(std::string& response, std::vector<AlgorithmDetectObject>& detects);
+		bool parseObjectDetectCompact(std::string& response, std::vector<AlgorithmDetectObject>& detects);
+		bool parseObjectDetectBatchCompact(std::string& response, std::vector<std::vector<AlgorithmDetectObject>>& detects);
+		Config* mConfig;
+		RequestPool* mRequestPool;
+		HostBalancer* mHostBalancer;
+	};
+}
+#endif //ANALYZER_ALGORITHMWITHAPI_H
@@ -0,0 +1,181 @@
+﻿#include "AlgorithmWithOnnx.h"
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "Utils/Log.h"
+#include "Config.h"
+
+namespace AVSAnalyzer {
+    // yolov5默认使用的coco数据集类别
+    static const char* COCO_CLASS_NAMES[] = {
+        "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+        "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+        "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+        "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+        "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+        "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+        "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+        "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+        "hair drier", "toothbrush"
+    };
+    static const int COCO_CLASS_NUM = sizeof(COCO_CLASS_NAMES) / sizeof(COCO_CLASS_NAMES[0]);
+
+    struct OnnxNet
+    {
+        cv::dnn::Net net;
+        std::mutex   mtx;
+    };
+
+    AlgorithmWithOnnx::AlgorithmWithOnnx(Config* config) :
+        mInputSize(config->algorithmOnnxInputSize),
+        mConfThreshold(config->algorithmOnnxConfThreshold),
+        mNmsThreshold(config->algorithmOnnxNmsThreshold),
+        mNextNet(0)
+    {
+        if (mInputSize < 32) {
+            mInputSize = 640;
+        }
+        int instances = config->algorithmOnnxInstances;
+        if (instances < 1) {
+            instances = 1;
+        }
+        for (int i = 0; i < instances; i++) {
+            OnnxNet* onnxNet = new OnnxNet;
+            try {
+                onnxNet->net = cv::dnn::readNetFromONNX(config->algorithmOnnxModel);
+            }
+            catch (const cv::Exception& e) {
+                LOGE("readNetFromONNX error: %s", e.what());
+                delete onnxNet;
+                break;
+            }
+            if (onnxNet->net.empty()) {
+                delete onnxNet;
+                break;
+            }
+            onnxNet->net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+            onnxNet->net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+            mNets.push_back(onnxNet);
+        }
+        LOGI("model=%s,instances=%d,inputSize=%d", config->algorithmOnnxModel.data(), (int)mNets.size(), mInputSize);
+    }
+
+    AlgorithmWithOnnx::~AlgorithmWithOnnx()
+    {
+        LOGI("");
+        for (int i = 0; i < mNets.size(); i++) {
+            delete mNets[i];
+        }
+        mNets.clear();
+    }
+
+    bool AlgorithmWithOnnx::test() {
+        return !mNets.empty();
+    }
+
+    OnnxNet* AlgorithmWithOnnx::gainNet() {
+        // 轮询分配模型实例，实例数少于检测线程数时在实例的锁上等待
+        unsigned int index = mNextNet++;
+        return mNets[index % mNets.size()];
+    }
+
+    bool AlgorithmWithOnnx::objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects) {
+        if (mNets.empty()) {
+            return false;
+        }
+
+        // letterbox：等比缩放后放在输入图像的左上角，其余部分填充灰色
+        cv::Mat image(height, width, CV_8UC3, bgr);
+        float scale = std::min((float)mInputSize / width, (float)mInputSize / height);
+        int resizeWidth = std::min(mInputSize, (int)(width * scale + 0.5f));
+        int resizeHeight = std::min(mInputSize, (int)(height * scale + 0.5f));
+
+        cv::Mat input(mInputSize, mInputSize, CV_8UC3, cv::Scalar(114, 114, 114));
+        cv::Mat roi = input(cv::Rect(0, 0, resizeWidth, resizeHeight));
+        if (resizeWidth == width && resizeHeight == height) {
+            image.copyTo(roi);
+        }
+        else {
+            cv::resize(image, roi, cv::Size(resizeWidth, resizeHeight), 0, 0, cv::INTER_LINEAR);
+        }
+        cv::Mat blob = cv::dnn::blobFromImage(input, 1 / 255.0, cv::Size(mInputSize, mInputSize), cv::Scalar(), true, false);
+
+        cv::Mat output;
+        OnnxNet* onnxNet = gainNet();
+        try {
+            std::unique_lock<std::mutex> lck(onnxNet->mtx);
+            onnxNet->net.setInput(blob);
+            output = onnxNet->net.forward();
+        }
+        catch (const cv::Exception& e) {
+            LOGE("forward error: %s", e.what());
+            return false;
+        }
+        if (output.dims != 3 || output.size[2] <= 5) {
+            LOGE("unsupported output dims=%d", output.dims);
+            return false;
+        }
+
+        int rows = output.size[1];
+        int dimensions = output.size[2];
+        int classNum = dimensions - 5;
+        const float* data = (const float*)output.data;
+
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> classIds;
+        for (int i = 0; i < rows; i++, data += dimensions) {
+            float objectness = data[4];
+            if (objectness < mConfThreshold) {
+                continue;
+            }
+            int classId = 0;
+            float classScore = data[5];
+            for (int c = 1; c < classNum; c++) {
+                if (data[5 + c] > classScore) {
+                    classScore = data[5 + c];
+                    classId = c;
+                }
+            }
+            float score = objectness * classScore;
+            if (score < mConfThreshold) {
+                continue;
+            }
+            // 中心点和宽高为输入图像坐标，映射回原图坐标
+            float cx = data[0] / scale;
+            float cy = data[1] / scale;
+            float w = data[2] / scale;
+            float h = data[3] / scale;
+            // 不同类别的框加上偏移，一次nms只抑制同类别的框
+            int offset = classId * 8192;
+            boxes.push_back(cv::Rect((int)(cx - w / 2) + offset, (int)(cy - h / 2) + offset, (int)w, (int)h));
+            scores.push_back(score);
+            classIds.push_back(classId);
+        }
+
+        std::vector<int> indices;
+        cv::dnn::NMSBoxes(boxes, scores, mConfThreshold, mNmsThreshold, indices);
+
+        for (int i = 0; i < indices.size(); i++) {
+            int index = indices[i];
+            int offset = classIds[index] * 8192;
+            const cv::Rect& box = boxes[index];
+
+            AlgorithmDetectObject detect;
+            detect.x1 = std::max(0, std::min(width - 1, box.x - offset));
+            detect.y1 = std::max(0, std::min(height - 1, box.y - offset));
+            detect.x2 = std::max(0, std::min(width - 1, box.x - offset + box.width));
+            detect.y2 = std::max(0, std::min(height - 1, box.y - offset + box.height));
+            detect.score = scores[index];
+            if (classIds[index] < COCO_CLASS_NUM) {
+                detect.class_name = COCO_CLASS_NAMES[classIds[index]];
+            }
+            else {
+                detect.class_name = std::to_string(classIds[index]);
+            }
+            detects.push_back(detect);
+        }
+
+        return true;
+    }
+}
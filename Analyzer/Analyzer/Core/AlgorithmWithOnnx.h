@@ -0,0 +1,33 @@
+﻿#ifndef ANALYZER_ALGORITHMWITHONNX_H
+#define ANALYZER_ALGORITHMWITHONNX_H
+
+#include <atomic>
+#include "Algorithm.h"
+
+namespace AVSAnalyzer {
+	class Config;
+	struct OnnxNet;
+
+	/*
+	进程内通过OpenCV DNN在CPU上运行yolov5导出的onnx模型，输出格式为 [1, N, 5 + 类别数]
+	cv::dnn::Net不支持多线程同时forward，因此加载多个模型实例，每个实例同一时间只被一个检测线程使用
+	*/
+	class AlgorithmWithOnnx : public Algorithm
+	{
+	public:
+		AlgorithmWithOnnx() = delete;
+		explicit AlgorithmWithOnnx(Config* config);
+		virtual ~AlgorithmWithOnnx();
+	public:
+		virtual bool test();// 模型是否加载成功
+		virtual bool objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects);
+	private:
+		OnnxNet* gainNet();
+		int   mInputSize;
+		float mConfThreshold;
+		float mNmsThreshold;
+		std::vector<OnnxNet*> mNets;
+		std::atomic<unsigned int> mNextNet;
+	};
+}
+#endif //ANALYZER_ALGORITHMWITHONNX_H
@@ -1,251 +1,249 @@
 ﻿#include "Analyzer.h"
 #include <opencv2/opencv.hpp>
-#include <json/json.h>
-#include "Utils/Request.h"
 #include "Utils/Log.h"
 #include "Utils/Common.h"
-#include "Utils/Base64.h"
+#include "Utils/ColorConvert.h"
 #include "Scheduler.h"
 #include "Config.h"
 #include "Control.h"
-
-#ifndef WIN32
-#include <opencv2/opencv.hpp>
-#else
-#ifndef _DEBUG
-#include <turbojpeg.h>
-#else
-#include <opencv2/opencv.hpp>
-#endif
-#endif
+#include "AlgorithmWithApi.h"
+#include "InferenceExecutor.h"
+#include "CheckRateController.h"
+#include "MotionGate.h"
 
 namespace AVSAnalyzer {
 
-    static bool analy_turboJpeg_compress(int height, int width, int channels, unsigned char* bgr, unsigned char*& out_data, unsigned long* out_size) {
-#ifdef WIN32
-#ifndef _DEBUG
-
-        tjhandle handle = tjInitCompress();
-        if (nullptr == handle) {
-            return false;
+    Analyzer::Analyzer(Scheduler* scheduler, Control* control) :
+        mScheduler(scheduler),
+        mControl(control),
+        mInferenceExecutor(scheduler->getInferenceExecutor())
+    {
+        std::string backend = mControl->algorithmBackend.empty() ? scheduler->getConfig()->algorithmBackend : mControl->algorithmBackend;
+        if (backend == "onnx" && scheduler->getOnnxAlgorithm()) {
+            mAlgorithm = scheduler->getOnnxAlgorithm();
+            mAlgorithmOwned = false;
         }
-
-        //pixel_format : TJPF::TJPF_BGR or other
-        const int JPEG_QUALITY = 75;
-        int pixel_format = TJPF::TJPF_BGR;
-        int pitch = tjPixelSize[pixel_format] * width;
-        int ret = tjCompress2(handle, bgr, width, pitch, height, pixel_format,
-            &out_data, out_size, TJSAMP_444, JPEG_QUALITY, TJFLAG_FASTDCT);
-
-        tjDestroy(handle);
-
-        if (ret != 0) {
-            return false;
+        else {
+            mAlgorithm = new AlgorithmWithApi(scheduler->getConfig(), scheduler->getRequestPool(), scheduler->getHostBalancer());
+            mAlgorithmOwned = true;
+        }
+        mMaxInFlight = mControl->algorithmMaxInFlight > 0 ? mControl->algorithmMaxInFlight : scheduler->getConfig()->algorithmMaxInFlight;
+        if (mMaxInFlight < 1) {
+            mMaxInFlight = 1;
+        }
+        mCheckRateController = new CheckRateController(scheduler, control);
+        mMotionGate = nullptr;
+        if (mControl->motionGate) {
+            mMotionGate = new MotionGate(control, scheduler->getConfig()->motionMaxSkipMs);
         }
-        return true;
-#endif // !_DEBUG
-#endif
-
-        return false;
     }
 
-    static bool analy_compressBgrAndEncodeBase64(int height, int width, int channels, unsigned char* bgr, std::string& out_base64) {
-
-#ifdef WIN32
-#ifndef _DEBUG
-        unsigned char* jpeg_data = nullptr;
-        unsigned long  jpeg_size = 0;
-
-        analy_turboJpeg_compress(height, width, channels, bgr, jpeg_data, &jpeg_size);
-
-        if (jpeg_size > 0 && jpeg_data != nullptr) {
+    Analyzer::~Analyzer()
+    {
+        // 等待已提交的检测任务完成，任务中引用了当前实例和帧池中的帧
+        std::unique_lock<std::mutex> lck(mResult_mtx);
+        mResult_cv.wait(lck, [this] { return mInFlight == 0; });
+        lck.unlock();
 
-            Base64Encode(jpeg_data, jpeg_size, out_base64);
+        if (mAlgorithm) {
+            if (mAlgorithmOwned) {
+                delete mAlgorithm;
+            }
+            mAlgorithm = nullptr;
+        }
+        if (mCheckRateController) {
+            delete mCheckRateController;
+            mCheckRateController = nullptr;
+        }
+        if (mMotionGate) {
+            delete mMotionGate;
+            mMotionGate = nullptr;
+        }
+        mDetects.clear();
 
-            free(jpeg_data);
-            jpeg_data = nullptr;
+    }
 
-            return true;
+    bool Analyzer::isCheckReady() {
+        int64_t now = getCurTime();
+        if (!mCheckRateController->isDue(now)) {
+            return false;
         }
-        else {
+        std::unique_lock<std::mutex> lck(mResult_mtx);
+        if (mInFlight >= mMaxInFlight) {
+            mSkipCount++;
             return false;
         }
-
-
-#else
-        cv::Mat bgr_image(height, width, CV_8UC3, bgr);
-
-        std::vector<int> quality = { 100 };
-        std::vector<uchar> jpeg_data;
-        cv::imencode(".jpg", bgr_image, jpeg_data, quality);
-
-        Base64Encode(jpeg_data.data(), jpeg_data.size(), out_base64);
-
+        lck.unlock();
+        mCheckRateController->consume(now);
         return true;
-
-
-#endif // !_DEBUG
-#endif //WIN32
-    }
-
-    AlgorithmWithApi::AlgorithmWithApi(Config* config):mConfig(config)
-    {
-        LOGI("");
-    }
-
-    AlgorithmWithApi::~AlgorithmWithApi()
-    {
-        LOGI("");
     }
-    bool AlgorithmWithApi::test() {
-        std::string response;
-        int randIndex = rand() % mConfig->algorithmApiHosts.size();
-        std::string host = mConfig->algorithmApiHosts[randIndex];
-        std::string url = host + "/image/objectDetect";
-
-        Request request;
-        bool ret = request.get(url.data(), response);
-
-        //LOGI("ret=%d,response=%s",ret,response.data());
-        return ret;
 
+    bool Analyzer::isSceneChanged(const unsigned char* yuv) {
+        if (!mMotionGate) {
+            return true;
+        }
+        return mMotionGate->check(yuv, getCurTime());
     }
 
-    bool AlgorithmWithApi::objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects) {
-        cv::Mat image(height, width, CV_8UC3, bgr);
-
-        int64_t t1 = getCurTime();
-        std::string imageBase64;
-        analy_compressBgrAndEncodeBase64(image.rows, image.cols, 3, image.data, imageBase64);
-        int64_t t2 = getCurTime();
+    bool Analyzer::checkVideoFrame(bool check, int64_t frameCount, VideoFramePtr frame, float& happenScore) {
 
-        int randIndex = rand() % mConfig->algorithmApiHosts.size();
-        std::string host = mConfig->algorithmApiHosts[randIndex];
-        std::string url = host+"/image/objectDetect";
+        //cv::Mat image = cv::imread("D:\\file\\data\\images\\1.jpg");
+        //cv::imshow("image", image);
+        //cv::waitKey(0);
+        //cv::destroyAllWindows();
 
-        Json::Value param;
-        param["appKey"] = "s84dsd#7hf34r3jsk@fs$d#$dd";
-        param["algorithm"] = "openvino_yolov5";
-        param["image_base64"] = imageBase64;
-        std::string data = param.toStyledString();
-        param = NULL;
+        if (check && frame) {
+            InferenceTask task;
+            task.analyzer = this;
+            task.frameCount = frameCount;
+            task.submitTime = getCurTime();
+            task.frame = frame;
 
-        int64_t t3 = getCurTime();
-        Request request;
-        std::string response;
-        bool result = request.post(url.data(), data.data(), response);
-        int64_t t4 = getCurTime();
+            mResult_mtx.lock();
+            mInFlight++;
+            mResult_mtx.unlock();
 
-        if (result) {
-            result = this->parseObjectDetect(response, detects);
+            mInferenceExecutor->submit(task);
         }
 
-        //LOGI("serialize spend: %lld(ms),call api spend: %lld(ms)", (t2 - t1), (t4 - t3));
+        // 使用最近一次完成的检测结果
+        std::unique_lock<std::mutex> lck(mResult_mtx);
+        if (mDrawVersion != mResultVersion) {
+            mDetects = mResultDetects;
+            mDrawVersion = mResultVersion;
+            if (!mDetects.empty()) {
+                mCheckRateController->boost(getCurTime());
+            }
+        }
+        happenScore = mResultHappenScore;
+        return mResultHappen;
 
-        return result;
     }
-    bool AlgorithmWithApi::parseObjectDetect(std::string& response, std::vector<AlgorithmDetectObject>& detects) {
-
-        Json::CharReaderBuilder builder;
-        const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-
-        //Json::CharReaderBuilder b;
-        //Json::CharReader* reader(b.newCharReader());
 
-        Json::Value root;
-        JSONCPP_STRING errs;
-
-        bool result = false;
-
-        if (reader->parse(response.data(), response.data() + std::strlen(response.data()),
-            &root, &errs) && errs.empty()) {
-
-
-            if (root["code"].isInt()) {
-                int code = root["code"].asInt();
-                std::string msg = root["msg"].asString();
-
-                if (code == 1000) {
-                    Json::Value root_result = root["result"];
-                    int detect_num = root_result["detect_num"].asInt();
-                    Json::Value detect_data = root_result["detect_data"];
-
-                    for (auto i : detect_data) {
-                        AlgorithmDetectObject object;
-
-                        Json::Value loc = i["location"];
-                        object.x1 = loc["x1"].asInt();
-                        object.y1 = loc["y1"].asInt();
-                        object.x2 = loc["x2"].asInt();
-                        object.y2 = loc["y2"].asInt();
-                        object.score = i["score"].asFloat();
-                        object.class_name = i["class_name"].asString();
+    bool Analyzer::isBatchable() {
+        return mAlgorithm->isBatchable();
+    }
+    void Analyzer::handleInference(InferenceTask& task) {
+        std::vector<AlgorithmDetectObject> detects;
+        bool result = mAlgorithm->objectDetect(task.frame->height, task.frame->width, task.frame->data, detects);
+        handleInferenceResult(task, result, detects);
+    }
+    void Analyzer::handleInferenceResult(InferenceTask& task, bool result, std::vector<AlgorithmDetectObject>& detects) {
+        int width = task.frame->width;
+        int height = task.frame->height;
 
-                        detects.push_back(object);
+        if (result && (width != mControl->videoWidth || height != mControl->videoHeight)) {
+            remapDetects(detects, width, height);
+        }
 
-                    }
-                    result = true;
-                }
+        if (result) {
+            //当检测到视频中有两个人的时候，认为发生了危险行为
+            bool happen = false;
+            float happenScore = 0;
+            if (detects.size() == 2) {
+                //LOGI("当前帧发现了危险行为");
+                happen = true;
+                happenScore = 0.9;
             }
 
-
+            std::unique_lock<std::mutex> lck(mResult_mtx);
+            // 同时检测多帧时结果可能乱序返回，只保留更新的帧的结果
+            if (task.frameCount > mResultFrameCount) {
+                mResultFrameCount = task.frameCount;
+                mResultDetects.swap(detects);
+                mResultHappen = happen;
+                mResultHappenScore = happenScore;
+                mResultVersion++;
+            }
+            mLatency = getCurTime() - task.submitTime;
+        }
+        else {
+            // 检测失败时清除上一次的结果，否则算法服务不可用期间之后的每一帧都沿用“发生事件”，持续产生报警
+            std::unique_lock<std::mutex> lck(mResult_mtx);
+            if (task.frameCount > mResultFrameCount) {
+                mResultFrameCount = task.frameCount;
+                mResultDetects.clear();
+                mResultHappen = false;
+                mResultHappenScore = 0;
+                mResultVersion++;
+            }
         }
 
-        root = NULL;
-        //delete reader;
-        //reader = NULL;
-
-        return result;
+        finishInference(task);
     }
+    void Analyzer::cancelInference(InferenceTask& task) {
+        finishInference(task);
+    }
+    void Analyzer::finishInference(InferenceTask& task) {
+        // 先归还帧，再减少检测中任务数，保证Analyzer析构后帧池中没有未归还的帧
+        task.frame.reset();
+
+        // 持有锁时通知，析构等待到mInFlight为0时条件变量仍然有效
+        std::unique_lock<std::mutex> lck(mResult_mtx);
+        mInFlight--;
+        mResult_cv.notify_all();
+    }
+    void Analyzer::getInferenceStats(int& inFlight, int64_t& skipCount, int64_t& latency, int64_t& motionSkipCount) {
+        motionSkipCount = mMotionGate ? mMotionGate->getSkipCount() : 0;
 
-
-    Analyzer::Analyzer(Scheduler* scheduler, Control* control) :
-        mScheduler(scheduler),
-        mControl(control)
-    {
-        mAlgorithm = new AlgorithmWithApi(scheduler->getConfig());
+        std::unique_lock<std::mutex> lck(mResult_mtx);
+        inFlight = mInFlight;
+        skipCount = mSkipCount;
+        latency = mLatency;
     }
+    void Analyzer::remapDetects(std::vector<AlgorithmDetectObject>& detects, int width, int height) {
+        float scaleX = float(mControl->videoWidth) / width;
+        float scaleY = float(mControl->videoHeight) / height;
+        int maxX = mControl->videoWidth - 1;
+        int maxY = mControl->videoHeight - 1;
 
-    Analyzer::~Analyzer()
-    {
-        if (mAlgorithm) {
-            delete mAlgorithm;
-            mAlgorithm = nullptr;
+        for (int i = 0; i < detects.size(); i++)
+        {
+            AlgorithmDetectObject& object = detects[i];
+            object.x1 = std::min(std::max(int(object.x1 * scaleX + 0.5f), 0), maxX);
+            object.y1 = std::min(std::max(int(object.y1 * scaleY + 0.5f), 0), maxY);
+            object.x2 = std::min(std::max(int(object.x2 * scaleX + 0.5f), 0), maxX);
+            object.y2 = std::min(std::max(int(object.y2 * scaleY + 0.5f), 0), maxY);
         }
-        mDetects.clear();
-
     }
+    void Analyzer::drawVideoFrame(unsigned char* bgr) {
 
-    bool Analyzer::checkVideoFrame(bool check, int64_t frameCount, unsigned char* data, float& happenScore) {
-        bool happen = false;
-
-        cv::Mat image(mControl->videoHeight, mControl->videoWidth, CV_8UC3, data);
-        //cv::Mat image = cv::imread("D:\\file\\data\\images\\1.jpg");
-        //cv::imshow("image", image);
-        //cv::waitKey(0);
-        //cv::destroyAllWindows();
+        cv::Mat image(mControl->videoHeight, mControl->videoWidth, CV_8UC3, bgr);
 
-        //int target_width = 300;
-        //int target_height = 200;
-        //int target_left = (mWidth - target_width) / 2;
-        //int target_top = (mHeight - target_height) / 2;
+        int x1, y1, x2, y2;
+        for (int i = 0; i < mDetects.size(); i++)
+        {
+            x1 = mDetects[i].x1;
+            y1 = mDetects[i].y1;
+            x2 = mDetects[i].x2;
+            y2 = mDetects[i].y2;
+            cv::rectangle(image, cv::Rect(x1, y1, (x2 - x1), (y2 - y1)), cv::Scalar(0, 255, 0), 2, cv::LINE_8, 0);
 
-        //cv::rectangle(image,cv::Rect(target_left,target_top,target_width,target_height),
-        //              cv::Scalar(0,255,0),3
-        //        ,cv::LINE_8,0);
+            std::string class_name = mDetects[i].class_name + "-" + std::to_string(mDetects[i].score);
+            cv::putText(image, class_name, cv::Point(x1, y1 + 15), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1, cv::LINE_AA);
 
-        if (check) {
-            mDetects.clear();
-            mAlgorithm->objectDetect(mControl->videoHeight, mControl->videoWidth, data, mDetects);
+        }
+        std::string info = "checkFps:" + std::to_string(mControl->checkFps);
+        cv::putText(image, info, cv::Point(20, 40), cv::FONT_HERSHEY_COMPLEX, mControl->videoWidth / 1000.0, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
 
-            //当检测到视频中有两个人的时候，认为发生了危险行为
-            if (mDetects.size() == 2) {
-                //LOGI("当前帧发现了危险行为");
-                happen = true;
-                happenScore = 0.9;
-            }
+    }
+    void Analyzer::drawVideoFrameYuv420p(unsigned char* yuv) {
+        // 亮度平面按原坐标绘制，色度平面按1/2坐标绘制，颜色换算为对应的y、u、v分量
+        int width = mControl->videoWidth;
+        int height = mControl->videoHeight;
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        cv::Mat planeY(height, width, CV_8UC1, yuv);
+        cv::Mat planeU(chromaHeight, chromaWidth, CV_8UC1, yuv + width * height);
+        cv::Mat planeV(chromaHeight, chromaWidth, CV_8UC1, yuv + width * height + chromaWidth * chromaHeight);
+
+        unsigned char boxY, boxU, boxV;
+        bgrColorToYuv(0, 255, 0, boxY, boxU, boxV);
+        unsigned char textY, textU, textV;
+        bgrColorToYuv(255, 255, 255, textY, textU, textV);
+        unsigned char infoY, infoU, infoV;
+        bgrColorToYuv(0, 0, 255, infoY, infoU, infoV);
 
-        }
         int x1, y1, x2, y2;
         for (int i = 0; i < mDetects.size(); i++)
         {
@@ -253,16 +251,21 @@ namespace AVSAnalyzer {
             y1 = mDetects[i].y1;
             x2 = mDetects[i].x2;
             y2 = mDetects[i].y2;
-            cv::rectangle(image, cv::Rect(x1, y1, (x2 - x1), (y2 - y1)), cv::Scalar(0, 255, 0), 2, cv::LINE_8, 0);
+            cv::rectangle(planeY, cv::Rect(x1, y1, (x2 - x1), (y2 - y1)), cv::Scalar(boxY), 2, cv::LINE_8, 0);
+            cv::rectangle(planeU, cv::Rect(x1 / 2, y1 / 2, (x2 - x1) / 2, (y2 - y1) / 2), cv::Scalar(boxU), 1, cv::LINE_8, 0);
+            cv::rectangle(planeV, cv::Rect(x1 / 2, y1 / 2, (x2 - x1) / 2, (y2 - y1) / 2), cv::Scalar(boxV), 1, cv::LINE_8, 0);
 
             std::string class_name = mDetects[i].class_name + "-" + std::to_string(mDetects[i].score);
-            cv::putText(image, class_name, cv::Point(x1, y1 + 15), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1, cv::LINE_AA);
+            cv::putText(planeY, class_name, cv::Point(x1, y1 + 15), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(textY), 1, cv::LINE_AA);
+            cv::putText(planeU, class_name, cv::Point(x1 / 2, (y1 + 15) / 2), cv::FONT_HERSHEY_SIMPLEX, 0.25, cv::Scalar(textU), 1, cv::LINE_AA);
+            cv::putText(planeV, class_name, cv::Point(x1 / 2, (y1 + 15) / 2), cv::FONT_HERSHEY_SIMPLEX, 0.25, cv::Scalar(textV), 1, cv::LINE_AA);
 
         }
         std::string info = "checkFps:" + std::to_string(mControl->checkFps);
-        cv::putText(image, info, cv::Point(20, 40), cv::FONT_HERSHEY_COMPLEX, mControl->videoWidth / 1000, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-
-        return happen;
+        double infoScale = mControl->videoWidth / 1000.0;
+        cv::putText(planeY, info, cv::Point(20, 40), cv::FONT_HERSHEY_COMPLEX, infoScale, cv::Scalar(infoY), 1, cv::LINE_AA);
+        cv::putText(planeU, info, cv::Point(10, 20), cv::FONT_HERSHEY_COMPLEX, infoScale / 2, cv::Scalar(infoU), 1, cv::LINE_AA);
+        cv::putText(planeV, info, cv::Point(10, 20), cv::FONT_HERSHEY_COMPLEX, infoScale / 2, cv::Scalar(infoV), 1, cv::LINE_AA);
 
     }
     bool Analyzer::checkAudioFrame(bool check, int64_t frameCount, unsigned char* data, int size) {
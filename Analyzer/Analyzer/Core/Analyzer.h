@@ -3,35 +3,19 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "VideoFrame.h"
+#include "Algorithm.h"
 
 namespace AVSAnalyzer {
 	struct Control;
 	class Config;
 	class Scheduler;
-
-	struct AlgorithmDetectObject
-	{
-		int x1;
-		int y1;
-		int x2;
-		int y2;
-		float score;
-		std::string class_name;
-	};
-
-	class AlgorithmWithApi
-	{
-	public:
-		AlgorithmWithApi() = delete;
-		AlgorithmWithApi(Config* config);
-		~AlgorithmWithApi();
-	public:
-		bool test();
-		bool objectDetect(int height, int width, unsigned char* bgr, std::vector<AlgorithmDetectObject>& detects);
-	private:
-		bool parseObjectDetect(std::string& response, std::vector<AlgorithmDetectObject>& detects);
-		Config* mConfig;
-	};
+	class InferenceExecutor;
+	struct InferenceTask;
+	class CheckRateController;
+	class MotionGate;
 
 	class Analyzer
 	{
@@ -39,14 +23,49 @@ namespace AVSAnalyzer {
 		explicit Analyzer(Scheduler* scheduler, Control* control);
 		~Analyzer();
 	public:
-		bool checkVideoFrame(bool check, int64_t frameCount, unsigned char* data, float& happenScore);
+		bool isCheckReady();// 到了检测时间且检测中的任务数未达到上限，可以提交新的检测帧
+		bool isSceneChanged(const unsigned char* yuv);// 与上一次送检帧相比画面是否发生了变化，yuv为yuv420p帧
+		// check为true时将frame（送入算法的bgr帧）异步提交检测，不等待结果
+		// 返回值和happenScore取最近一次完成的检测结果，检测结果会映射回原视频坐标
+		bool checkVideoFrame(bool check, int64_t frameCount, VideoFramePtr frame, float& happenScore);
+		void drawVideoFrame(unsigned char* bgr);        // 在bgr帧上绘制检测结果
+		void drawVideoFrameYuv420p(unsigned char* yuv); // 在yuv420p帧上直接绘制检测结果
 		bool checkAudioFrame(bool check, int64_t frameCount, unsigned char* data, int size);
 
+		// 由InferenceExecutor的检测线程调用
+		void handleInference(InferenceTask& task);
+		void handleInferenceResult(InferenceTask& task, bool result, std::vector<AlgorithmDetectObject>& detects);// 批量检测完成后调用
+		void cancelInference(InferenceTask& task);
+		bool isBatchable();// 检测帧是否可以和其他布控合并为一次请求
+		void getInferenceStats(int& inFlight, int64_t& skipCount, int64_t& latency, int64_t& motionSkipCount);
+
 	private:
+		void remapDetects(std::vector<AlgorithmDetectObject>& detects, int width, int height);// 将检测框从算法输入尺寸映射回原视频尺寸
+		void finishInference(InferenceTask& task);
 		Scheduler* mScheduler;
 		Control*   mControl;
-		AlgorithmWithApi* mAlgorithm;
-		std::vector<AlgorithmDetectObject> mDetects;
+		Algorithm* mAlgorithm;
+		bool mAlgorithmOwned;// mAlgorithm由当前实例创建，析构时释放；onnx模型由Scheduler共享
+		InferenceExecutor* mInferenceExecutor;
+		CheckRateController* mCheckRateController;
+		MotionGate* mMotionGate;// 未开启时为nullptr
+		int  mMaxInFlight;
+
+		std::vector<AlgorithmDetectObject> mDetects;// 解码线程绘制使用的检测结果
+
+		// 检测线程写入，解码线程读取 start
+		std::mutex              mResult_mtx;
+		std::condition_variable mResult_cv;
+		int     mInFlight = 0;              // 正在检测中的任务数
+		int64_t mSkipCount = 0;             // 达到检测中任务数上限而未提交的次数
+		int64_t mLatency = 0;               // 最近一次检测的耗时（毫秒）
+		int64_t mResultFrameCount = -1;     // 最近一次完成检测的帧序号
+		int64_t mResultVersion = 0;         // 检测结果更新次数
+		std::vector<AlgorithmDetectObject> mResultDetects;
+		bool    mResultHappen = false;
+		float   mResultHappenScore = 0;
+		// 检测线程写入，解码线程读取 end
+		int64_t mDrawVersion = 0;           // mDetects对应的检测结果版本
 	};
 }
 #endif //ANALYZER_ANALYZER_H
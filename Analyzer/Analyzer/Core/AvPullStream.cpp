@@ -7,7 +7,11 @@
 namespace AVSAnalyzer {
     AvPullStream::AvPullStream(Config* config, Control* control) :
         mConfig(config),
-        mControl(control)
+        mControl(control),
+        mVideoPktQ(config->videoPktQueueCapacity,
+            parseQueueDropPolicy(config->videoPktQueuePolicy, QUEUE_DROP_NON_KEYFRAME),
+            [](AVPacket& pkt) { av_packet_unref(&pkt); },
+            [](const AVPacket& pkt) { return (pkt.flags & AV_PKT_FLAG_KEY) != 0; })
     {
         LOGI("");
     }
@@ -60,14 +64,25 @@ namespace AVSAnalyzer {
             AVCodecParameters* videoCodecPar = mFmtCtx->streams[mControl->videoIndex]->codecpar;
 
             AVCodec* videoCodec = NULL;
+            bool isHardware = false;
             if (mConfig->supportHardwareVideoDecode) {
+                const char* codecName = nullptr;
                 if (AV_CODEC_ID_H264 == videoCodecPar->codec_id) {
-                    if (!videoCodec) {
-                        videoCodec = avcodec_find_decoder_by_name("h264_cuvid");// 英伟达独显
-                        //videoCodec = avcodec_find_decoder_by_name("h264_qsv");// 酷睿核显
-                        if (videoCodec) {
-                            LOGI("avcodec_find_decoder_by_name = h264_cuvid");
-                        }
+                    codecName = "h264";
+                }
+                else if (AV_CODEC_ID_HEVC == videoCodecPar->codec_id) {
+                    codecName = "hevc";
+                }
+                if (codecName) {
+                    // 如 h264_cuvid，hevc_cuvid，h264_qsv，hevc_qsv
+                    std::string decoderName = std::string(codecName) + "_" + mConfig->hardwareVideoDecoder;
+                    videoCodec = avcodec_find_decoder_by_name(decoderName.data());
+                    if (videoCodec) {
+                        isHardware = true;
+                        LOGI("avcodec_find_decoder_by_name = %s", decoderName.data());
+                    }
+                    else {
+                        LOGE("avcodec_find_decoder_by_name error: %s", decoderName.data());
                     }
                 }
             }
@@ -85,11 +100,44 @@ namespace AVSAnalyzer {
                 LOGE("avcodec_parameters_to_context error");
                 return false;
             }
+            // 多线程和跳过解码的参数必须在avcodec_open2之前设置
+            if (!isHardware) {
+                mVideoCodecCtx->thread_count = mControl->videoDecodeThreads > 0 ? mControl->videoDecodeThreads : 1;
+                if ("slice" == mConfig->videoDecodeThreadType) {
+                    mVideoCodecCtx->thread_type = FF_THREAD_SLICE;
+                }
+                else if ("auto" == mConfig->videoDecodeThreadType) {
+                    mVideoCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+                }
+                else {
+                    mVideoCodecCtx->thread_type = FF_THREAD_FRAME;
+                }
+                // 只解码部分pkt时帧级多线程要攒够线程数个pkt才输出帧，改为片级多线程
+                if ("full" != mControl->decodeMode && !mControl->pushStream) {
+                    mVideoCodecCtx->thread_type = FF_THREAD_SLICE;
+                }
+
+                // 只分析不推流时画质要求低，跳过环路滤波可以明显降低解码耗时
+                // nonref会丢弃非参考帧（通常是B帧），报警视频的帧数也会随之减少
+                std::string skipMode = mControl->decodeSkipMode;
+                if ("auto" == skipMode) {
+                    skipMode = mControl->pushStream ? "none" : "loopFilter";
+                }
+                if ("loopFilter" == skipMode || "nonref" == skipMode) {
+                    mVideoCodecCtx->skip_loop_filter = AVDISCARD_ALL;
+                }
+                if ("nonref" == skipMode) {
+                    mVideoCodecCtx->skip_frame = AVDISCARD_NONREF;
+                }
+            }
             if (avcodec_open2(mVideoCodecCtx, videoCodec, nullptr) < 0) {
                 LOGE("avcodec_open2 error");
                 return false;
             }
-            //mVideoCodecCtx->thread_count = 1;
+            mControl->videoDecoder = videoCodec->name;
+            LOGI("videoDecoder=%s,threadCount=%d,threadType=%d,skipLoopFilter=%d,skipFrame=%d", videoCodec->name,
+                mVideoCodecCtx->thread_count, mVideoCodecCtx->thread_type,
+                mVideoCodecCtx->skip_loop_filter, mVideoCodecCtx->skip_frame);
 
             mVideoStream = mFmtCtx->streams[mControl->videoIndex];
             if (0 == mVideoStream->avg_frame_rate.den) {
@@ -103,6 +151,30 @@ namespace AVSAnalyzer {
             }
 
 
+            // 点播文件有时长信息，直播流没有
+            mIsLive = !mFmtCtx->pb || mFmtCtx->duration == AV_NOPTS_VALUE || mFmtCtx->duration <= 0;
+            if ("fast" == mControl->pullMode) {
+                mPaceByPts = false;
+            }
+            else if ("realtime" == mControl->pullMode) {
+                mPaceByPts = true;
+            }
+            else {
+                mPaceByPts = !mIsLive;
+            }
+            mPaceStartDts = AV_NOPTS_VALUE;
+
+            // 非直播流不需要丢帧，队列满时一直阻塞读取，解码落后多久都不丢pkt
+            if (!mIsLive || "fast" == mControl->pullMode) {
+                mVideoPktQ.setPolicy(QUEUE_BLOCK);
+                mVideoPktQ.setBlockTimeout(0);
+            }
+            else {
+                mVideoPktQ.setPolicy(parseQueueDropPolicy(mConfig->videoPktQueuePolicy, QUEUE_DROP_NON_KEYFRAME));
+                mVideoPktQ.setBlockTimeout(1000);
+            }
+            LOGI("isLive=%d,pullMode=%s,paceByPts=%d", mIsLive, mControl->pullMode.data(), mPaceByPts);
+
             mControl->videoWidth = mVideoCodecCtx->width;
             mControl->videoHeight = mVideoCodecCtx->height;
             mControl->videoChannel = 3;
@@ -173,63 +245,95 @@ namespace AVSAnalyzer {
         }
     }
 
-    bool AvPullStream::pushVideoPkt(const AVPacket& pkt) {
+    bool AvPullStream::pushVideoPkt(AVPacket& pkt) {
 
-        if (av_packet_make_refcounted((AVPacket*)&pkt) < 0) {
+        if (av_packet_make_refcounted(&pkt) < 0) {
+            av_packet_unref(&pkt);
             return false;
         }
 
-        mVideoPktQ_mtx.lock();
-        mVideoPktQ.push(pkt);
-        mVideoPktQ_mtx.unlock();
-
-        return true;
+        // 入队后pkt的数据归队列所有，失败时队列已释放
+        return mVideoPktQ.push(pkt);
 
     }
-    bool AvPullStream::getVideoPkt(AVPacket& pkt, int& pktQSize) {
-
-        mVideoPktQ_mtx.lock();
+    void AvPullStream::pushVideoEndPkt() {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+        pkt.stream_index = -1;
+        mVideoPktQ.push(pkt);
+    }
+    bool AvPullStream::isVideoEndPkt(const AVPacket& pkt) {
+        return pkt.stream_index < 0 && 0 == pkt.size;
+    }
+    void AvPullStream::paceVideoPkt(const AVPacket& pkt) {
 
-        if (!mVideoPktQ.empty()) {
-            pkt = mVideoPktQ.front();
-            mVideoPktQ.pop();
-            pktQSize = mVideoPktQ.size();
-            mVideoPktQ_mtx.unlock();
-            return true;
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        if (AV_NOPTS_VALUE == ts) {
+            return;
+        }
+        AVRational ms_time_base = { 1, 1000 };
+        int64_t dts = av_rescale_q(ts, mVideoStream->time_base, ms_time_base);
+        int64_t now = getCurTime();
+
+        if (AV_NOPTS_VALUE == mPaceStartDts) {
+            mPaceStartTime = now;
+            mPaceStartDts = dts;
+            return;
+        }
 
+        int64_t delay = (dts - mPaceStartDts) - (now - mPaceStartTime);
+        if (delay > 1000 || delay < -1000) {
+            // 时间戳跳变（循环播放、重连）或读取落后太多，重新对齐基准
+            mPaceStartTime = now;
+            mPaceStartDts = dts;
         }
-        else {
-            mVideoPktQ_mtx.unlock();
-            return false;
+        else if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
         }
+    }
+    bool AvPullStream::getVideoPkt(AVPacket& pkt, int& pktQSize) {
+
+        return mVideoPktQ.tryPop(pkt, pktQSize);
 
     }
+    bool AvPullStream::hasVideoPkt() {
+        return mVideoPktQ.size() > 0;
+    }
+    void AvPullStream::setVideoPktNotify(std::function<void()> notify) {
+        mVideoPktQ.setNotify(notify);
+    }
+    void AvPullStream::getVideoPktQueueStats(int& size, int64_t& dropCount) {
+        size = mVideoPktQ.size();
+        dropCount = mVideoPktQ.getDropCount();
+    }
     void AvPullStream::clearVideoPktQueue() {
-        mVideoPktQ_mtx.lock();
-        while (!mVideoPktQ.empty())
-        {
-            AVPacket pkt = mVideoPktQ.front();
-            mVideoPktQ.pop();
-
-            av_packet_unref(&pkt);
-        }
-        mVideoPktQ_mtx.unlock();
+        mVideoPktQ.clear();
+    }
+    void AvPullStream::stopVideoPktQueue() {
+        mVideoPktQ.stop();
     }
 
     void AvPullStream::readThread(void* arg) {
 
         ControlExecutor* executor = (ControlExecutor*)arg;
         int continuity_error_count = 0;
+        bool end_pkt_pushed = false;// 读取结束后只通知一次解码阶段
 
         AVPacket pkt;
         while (executor->getState())
         {
-            if (av_read_frame(executor->mPullStream->mFmtCtx, &pkt) >= 0) {
+            int ret = av_read_frame(executor->mPullStream->mFmtCtx, &pkt);
+            if (ret >= 0) {
                 continuity_error_count = 0;
+                end_pkt_pushed = false;
 
                 if (pkt.stream_index == executor->mControl->videoIndex) {
+                    if (executor->mPullStream->mPaceByPts) {
+                        executor->mPullStream->paceVideoPkt(pkt);
+                    }
                     executor->mPullStream->pushVideoPkt(pkt);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(30));
                 }
                 else {
                     //av_free_packet(&pkt);//过时
@@ -239,6 +343,11 @@ namespace AVSAnalyzer {
             else {
                 //av_free_packet(&pkt);//过时
                 av_packet_unref(&pkt);
+                if (AVERROR_EOF == ret && !end_pkt_pushed) {
+                    // 文件读取结束，解码器中还缓存着最后几帧
+                    executor->mPullStream->pushVideoEndPkt();
+                    end_pkt_pushed = true;
+                }
                 continuity_error_count++;
                 if (continuity_error_count > 5) {//大于5秒重启拉流连接
 
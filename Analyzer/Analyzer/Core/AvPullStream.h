@@ -1,8 +1,6 @@
 ﻿#ifndef ANALYZER_AVPULLSTREAM_H
 #define ANALYZER_AVPULLSTREAM_H
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include "Utils/BlockingQueue.h"
 
 extern "C" {
 #include "libavcodec/avcodec.h"
@@ -30,7 +28,14 @@ namespace AVSAnalyzer {
 		// 视频帧
 		AVCodecContext* mVideoCodecCtx = NULL;
 		AVStream* mVideoStream = NULL;
-		bool getVideoPkt(AVPacket& pkt, int& pktQSize);// 从队列获取的pkt，一定要主动释放!!!
+		bool mIsLive = true;    // 是否为直播流（无时长信息）
+		bool mPaceByPts = false;// 是否按时间戳控制读取速度
+		bool getVideoPkt(AVPacket& pkt, int& pktQSize);// 从队列获取的pkt，一定要主动释放!!! 不等待，队列为空时返回false
+		static bool isVideoEndPkt(const AVPacket& pkt);// 是否为读取结束时放入队列的空pkt，此时需要取出解码器中剩余的帧
+		bool hasVideoPkt();
+		void setVideoPktNotify(std::function<void()> notify);// 有新的pkt时通知
+		void getVideoPktQueueStats(int& size, int64_t& dropCount);
+		void stopVideoPktQueue();// 唤醒阻塞在队列上的读取线程，退出时调用
 
 
 	public:
@@ -39,10 +44,13 @@ namespace AVSAnalyzer {
 		Config* mConfig;
 		Control* mControl;
 
-		bool pushVideoPkt(const AVPacket& pkt);
+		bool pushVideoPkt(AVPacket& pkt);// 转移pkt的所有权，返回false时pkt已被释放
+		void pushVideoEndPkt();
+		void paceVideoPkt(const AVPacket& pkt);// 按时间戳等待到该pkt应该被读取的时刻
+		int64_t mPaceStartTime = 0;           // 节奏基准的系统时间（毫秒）
+		int64_t mPaceStartDts = AV_NOPTS_VALUE;// 节奏基准的时间戳（毫秒）
 		void clearVideoPktQueue();
-		std::queue <AVPacket>   mVideoPktQ;
-		std::mutex              mVideoPktQ_mtx;
+		BlockingQueue <AVPacket> mVideoPktQ;
 
 	};
 
@@ -5,6 +5,7 @@
 #include "Control.h"
 #include "ControlExecutor.h"
 #include "Analyzer.h"
+#include "Utils/ColorConvert.h"
 extern "C" {
 #include "libswscale/swscale.h"
 #include <libavutil/imgutils.h>
@@ -15,7 +16,12 @@ extern "C" {
 namespace AVSAnalyzer {
     AvPushStream::AvPushStream(Config* config, Control* control) :
         mConfig(config),
-        mControl(control)
+        mControl(control),
+        mVideoFrameQ(config->pushFrameQueueCapacity,
+            parseQueueDropPolicy(config->pushFrameQueuePolicy, QUEUE_DROP_OLDEST)),
+        mVideoPktQ(control->videoFps > 0 ? control->videoFps : 25, QUEUE_DROP_NON_KEYFRAME,
+            [](AVPacket& pkt) { av_packet_unref(&pkt); },
+            [](const AVPacket& pkt) { return (pkt.flags & AV_PKT_FLAG_KEY) != 0; })
     {
         LOGI("");
     }
@@ -23,8 +29,10 @@ namespace AVSAnalyzer {
     AvPushStream::~AvPushStream()
     {
         LOGI("");
+        releaseEncode();
         closeConnect();
         clearVideoFrameQueue();
+        mVideoPktQ.clear();
     }
 
 
@@ -183,204 +191,167 @@ namespace AVSAnalyzer {
         }
     }
 
-    void AvPushStream::pushVideoFrame(unsigned char* data, int size) {
+    void AvPushStream::pushVideoFrame(VideoFramePtr frame) {
 
-        VideoFrame* frame = NULL;
-        frame = new VideoFrame(VideoFrame::BGR, size, mControl->videoWidth, mControl->videoHeight);
-        frame->size = size;
-        memcpy(frame->data, data, size);
-
-        mVideoFrameQ_mtx.lock();
         mVideoFrameQ.push(frame);
-        mVideoFrameQ_mtx.unlock();
     }
-    bool AvPushStream::getVideoFrame(VideoFrame*& frame, int& frameQSize) {
-
-        mVideoFrameQ_mtx.lock();
+    void AvPushStream::getVideoFrameQueueStats(int& size, int64_t& dropCount) {
+        size = mVideoFrameQ.size();
+        dropCount = mVideoFrameQ.getDropCount();
+    }
+    void AvPushStream::clearVideoFrameQueue() {
 
-        if (!mVideoFrameQ.empty()) {
-            frame = mVideoFrameQ.front();
-            mVideoFrameQ.pop();
-            frameQSize = mVideoFrameQ.size();
-            mVideoFrameQ_mtx.unlock();
-            return true;
+        mVideoFrameQ.clear();
 
-        }
-        else {
-            frameQSize = 0;
-            mVideoFrameQ_mtx.unlock();
-            return false;
-        }
+    }
 
+    void AvPushStream::setVideoFrameNotify(std::function<void()> notify) {
+        mVideoFrameQ.setNotify(notify);
     }
-    void AvPushStream::clearVideoFrameQueue() {
+    bool AvPushStream::hasVideoFrame(void* arg) {
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        return executor->mPushStream->mVideoFrameQ.size() > 0;
+    }
+
+    void AvPushStream::writeVideoPktThread(void* arg) {
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        AvPushStream* pushStream = executor->mPushStream;
 
-        mVideoFrameQ_mtx.lock();
-        while (!mVideoFrameQ.empty())
+        AVPacket pkt;
+        int pktQSize = 0;
+        while (executor->getState())
         {
-            VideoFrame* frame = mVideoFrameQ.front();
-            mVideoFrameQ.pop();
-            delete frame;
-            frame = NULL;
+            if (!pushStream->mVideoPktQ.pop(pkt, pktQSize, 100)) {
+                continue;
+            }
+            int ret = av_interleaved_write_frame(pushStream->mFmtCtx, &pkt);
+            if (ret < 0) {
+                LOGE("av_interleaved_write_frame error : ret=%d", ret);
+            }
+            av_packet_unref(&pkt);
         }
-        mVideoFrameQ_mtx.unlock();
-
     }
 
-    void AvPushStream::encodeVideoAndWriteStreamThread(void* arg) {
-        ControlExecutor* executor = (ControlExecutor*)arg;
-        int width = executor->mControl->videoWidth;
-        int height = executor->mControl->videoHeight;
-
-        VideoFrame* videoFrame = NULL; // 未编码的视频帧（bgr格式）
-        int         videoFrameQSize = 0; // 未编码视频帧队列当前长度
+    bool AvPushStream::initEncode() {
+        int width = mControl->videoWidth;
+        int height = mControl->videoHeight;
 
-        AVFrame* frame_yuv420p = av_frame_alloc();
-        frame_yuv420p->format = executor->mPushStream->mVideoCodecCtx->pix_fmt;
-        frame_yuv420p->width = width;
-        frame_yuv420p->height = height;
+        mEncodeFrame = av_frame_alloc();
+        mEncodeFrame->format = mVideoCodecCtx->pix_fmt;
+        mEncodeFrame->width = width;
+        mEncodeFrame->height = height;
 
         int frame_yuv420p_buff_size = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, 1);
-        uint8_t* frame_yuv420p_buff = (uint8_t*)av_malloc(frame_yuv420p_buff_size);
-        av_image_fill_arrays(frame_yuv420p->data, frame_yuv420p->linesize,
-            frame_yuv420p_buff,
+        mEncodeFrameBuff = (uint8_t*)av_malloc(frame_yuv420p_buff_size);
+        av_image_fill_arrays(mEncodeFrame->data, mEncodeFrame->linesize,
+            mEncodeFrameBuff,
             AV_PIX_FMT_YUV420P,
             width, height, 1);
 
+        mEncodePkt = av_packet_alloc();
+        mEncodeFrameCount = 0;
+        return true;
+    }
+    void AvPushStream::releaseEncode() {
+        //av_write_trailer(mFmtCtx);//写文件尾
 
+        if (mEncodePkt) {
+            av_packet_free(&mEncodePkt);
+            mEncodePkt = NULL;
+        }
 
-        AVPacket* pkt = av_packet_alloc();// 编码后的视频帧
-        int64_t  encodeSuccessCount = 0;
-        int64_t  frameCount = 0;
+        if (mEncodeFrameBuff) {
+            av_free(mEncodeFrameBuff);
+            mEncodeFrameBuff = NULL;
+        }
 
-        int64_t t1 = 0;
-        int64_t t2 = 0;
-        int ret = -1;
-        while (executor->getState())
-        {
-            if (executor->mPushStream->getVideoFrame(videoFrame, videoFrameQSize)) {
+        if (mEncodeFrame) {
+            av_frame_free(&mEncodeFrame);
+            mEncodeFrame = NULL;
+        }
+    }
 
-                // frame_bgr 转  frame_yuv420p
-                executor->mPushStream->bgr24ToYuv420p(videoFrame->data, width, height, frame_yuv420p_buff);
-                delete videoFrame;
-                videoFrame = nullptr;
+    bool AvPushStream::encodeVideoFrame(void* arg) {
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        AvPushStream* pushStream = executor->mPushStream;
+        int width = executor->mControl->videoWidth;
+        int height = executor->mControl->videoHeight;
 
+        VideoFramePtr videoFrame; // 未编码的视频帧（bgr格式）
+        int         videoFrameQSize = 0; // 未编码视频帧队列当前长度
+        if (!pushStream->mVideoFrameQ.tryPop(videoFrame, videoFrameQSize)) {
+            return false;
+        }
+        if (!pushStream->mEncodeFrame) {
+            pushStream->initEncode();
+        }
 
-                frame_yuv420p->pts = frame_yuv420p->pkt_dts = av_rescale_q_rnd(frameCount,
-                    executor->mPushStream->mVideoCodecCtx->time_base,
-                    executor->mPushStream->mVideoStream->time_base,
-                    (AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
+        AVFrame* frame_yuv420p = pushStream->mEncodeFrame;
+        AVPacket* pkt = pushStream->mEncodePkt;
+        int64_t t1 = 0;
+        int64_t t2 = 0;
+        int ret = -1;
 
-                frame_yuv420p->pkt_duration = av_rescale_q_rnd(1,
-                    executor->mPushStream->mVideoCodecCtx->time_base,
-                    executor->mPushStream->mVideoStream->time_base,
-                    (AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
+        if (VideoFrame::YUV420P == videoFrame->type) {
+            // 已经是yuv420p，直接引用帧数据进行编码
+            av_image_fill_arrays(frame_yuv420p->data, frame_yuv420p->linesize,
+                videoFrame->data, AV_PIX_FMT_YUV420P, width, height, 1);
+        }
+        else {
+            av_image_fill_arrays(frame_yuv420p->data, frame_yuv420p->linesize,
+                pushStream->mEncodeFrameBuff, AV_PIX_FMT_YUV420P, width, height, 1);
+
+            // frame_bgr 转  frame_yuv420p
+            bgr24ToYuv420p(videoFrame->data, width * 3, width, height,
+                frame_yuv420p->data[0], frame_yuv420p->linesize[0],
+                frame_yuv420p->data[1], frame_yuv420p->linesize[1],
+                frame_yuv420p->data[2], frame_yuv420p->linesize[2]);
+        }
 
-                frame_yuv420p->pkt_pos = -1;
 
-                t1 = getCurTime();
-                ret = avcodec_send_frame(executor->mPushStream->mVideoCodecCtx, frame_yuv420p);
-                if (ret >= 0) {
-                    ret = avcodec_receive_packet(executor->mPushStream->mVideoCodecCtx, pkt);
-                    if (ret >= 0) {
-                        t2 =getCurTime();
-                        encodeSuccessCount++;
+        frame_yuv420p->pts = frame_yuv420p->pkt_dts = av_rescale_q_rnd(pushStream->mEncodeFrameCount,
+            pushStream->mVideoCodecCtx->time_base,
+            pushStream->mVideoStream->time_base,
+            (AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
 
-                        //LOGI("encode 1 frame spend：%lld(ms),frameCount=%lld, encodeSuccessCount = %lld, frameQSize=%d,ret=%d", 
-                        //    (t2 - t1), frameCount, encodeSuccessCount, frameQSize, ret);
-                        pkt->stream_index = executor->mPushStream->mVideoIndex;
+        frame_yuv420p->pkt_duration = av_rescale_q_rnd(1,
+            pushStream->mVideoCodecCtx->time_base,
+            pushStream->mVideoStream->time_base,
+            (AVRounding)(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
 
-                        pkt->pos = -1;
-                        pkt->duration = frame_yuv420p->pkt_duration;
+        frame_yuv420p->pkt_pos = -1;
 
-                        ret = av_interleaved_write_frame(executor->mPushStream->mFmtCtx, pkt);
-                        if (ret < 0) {
-                            LOGE("av_interleaved_write_frame error : ret=%d", ret);
-                        }
+        t1 = getCurTime();
+        ret = avcodec_send_frame(pushStream->mVideoCodecCtx, frame_yuv420p);
+        if (ret >= 0) {
+            ret = avcodec_receive_packet(pushStream->mVideoCodecCtx, pkt);
+            if (ret >= 0) {
+                t2 = getCurTime();
 
-                    }
-                    else {
-                        LOGE("avcodec_receive_packet error : ret=%d", ret);
-                    }
+                //LOGI("encode 1 frame spend：%lld(ms),frameCount=%lld, frameQSize=%d,ret=%d",
+                //    (t2 - t1), pushStream->mEncodeFrameCount, videoFrameQSize, ret);
+                pkt->stream_index = pushStream->mVideoIndex;
 
-                }
-                else {
-                    LOGE("avcodec_send_frame error : ret=%d", ret);
-                }
+                pkt->pos = -1;
+                pkt->duration = frame_yuv420p->pkt_duration;
 
-                frameCount++;
+                // 写网络会阻塞，交给写入线程；写入线程跟不上时丢弃到下一个关键帧
+                AVPacket writePkt;
+                av_packet_move_ref(&writePkt, pkt);
+                pushStream->mVideoPktQ.push(writePkt);
             }
             else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                LOGE("avcodec_receive_packet error : ret=%d", ret);
             }
-        }
-
-        //av_write_trailer(executor->mPushStream->mFmtCtx);//写文件尾
-
-        av_packet_unref(pkt);
-        pkt = NULL;
 
-
-        av_free(frame_yuv420p_buff);
-        frame_yuv420p_buff = NULL;
-
-        av_frame_free(&frame_yuv420p);
-        //av_frame_unref(frame_yuv420p);
-        frame_yuv420p = NULL;
-
-
-    }
-
-
-    unsigned char AvPushStream::clipValue(unsigned char x, unsigned char min_val, unsigned char  max_val) {
-
-        if (x > max_val) {
-            return max_val;
-        }
-        else if (x < min_val) {
-            return min_val;
         }
         else {
-            return x;
+            LOGE("avcodec_send_frame error : ret=%d", ret);
         }
-    }
 
-    bool AvPushStream::bgr24ToYuv420p(unsigned char* bgrBuf, int w, int h, unsigned char* yuvBuf) {
-
-        unsigned char* ptrY, * ptrU, * ptrV, * ptrRGB;
-        memset(yuvBuf, 0, w * h * 3 / 2);
-        ptrY = yuvBuf;
-        ptrU = yuvBuf + w * h;
-        ptrV = ptrU + (w * h * 1 / 4);
-        unsigned char y, u, v, r, g, b;
-
-        for (int j = 0; j < h; ++j) {
-
-            ptrRGB = bgrBuf + w * j * 3;
-            for (int i = 0; i < w; i++) {
-
-                b = *(ptrRGB++);
-                g = *(ptrRGB++);
-                r = *(ptrRGB++);
-
-
-                y = (unsigned char)((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
-                u = (unsigned char)((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
-                v = (unsigned char)((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
-                *(ptrY++) = clipValue(y, 0, 255);
-                if (j % 2 == 0 && i % 2 == 0) {
-                    *(ptrU++) = clipValue(u, 0, 255);
-                }
-                else {
-                    if (i % 2 == 0) {
-                        *(ptrV++) = clipValue(v, 0, 255);
-                    }
-                }
-            }
-        }
-        return true;
+        videoFrame.reset();// 编码器已复制帧数据，归还到帧池
+        pushStream->mEncodeFrameCount++;
 
+        return true;
     }
 }
-
-
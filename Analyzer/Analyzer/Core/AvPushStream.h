@@ -1,7 +1,7 @@
 ﻿#ifndef ANALYZER_AVPUSHSTREAM_H
 #define ANALYZER_AVPUSHSTREAM_H
-#include <queue>
-#include <mutex>
+#include "VideoFrame.h"
+#include "Utils/BlockingQueue.h"
 extern "C" {
 #include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
@@ -9,7 +9,6 @@ extern "C" {
 namespace AVSAnalyzer {
 	class Config;
 	struct Control;
-	struct VideoFrame;
 
 	class AvPushStream
 	{
@@ -28,25 +27,35 @@ namespace AVSAnalyzer {
 		AVCodecContext* mVideoCodecCtx = NULL;
 		AVStream* mVideoStream = NULL;
 		int mVideoIndex = -1;
-		void pushVideoFrame(unsigned char* data, int size);
+		void pushVideoFrame(VideoFramePtr frame);
+		void setVideoFrameNotify(std::function<void()> notify);// 有新的视频帧时通知
+		void getVideoFrameQueueStats(int& size, int64_t& dropCount);
 
 
 	public:
-		static void encodeVideoAndWriteStreamThread(void* arg); // 编码视频帧并推流
+		static bool encodeVideoFrame(void* arg); // 取一个视频帧编码后放入pkt队列，队列为空时返回false
+		static bool hasVideoFrame(void* arg);
+		static void writeVideoPktThread(void* arg);// 将编码后的pkt写入网络
 
 	private:
 		Config* mConfig;
 		Control* mControl;
 
 		//视频帧
-		std::queue <VideoFrame*> mVideoFrameQ;
-		std::mutex               mVideoFrameQ_mtx;
-		bool getVideoFrame(VideoFrame*& frame, int& frameQSize);// 获取的frame，需要pushReusedVideoFrame
+		BlockingQueue <VideoFramePtr> mVideoFrameQ;
 		void clearVideoFrameQueue();
 
-		// bgr24转yuv420p
-		unsigned char clipValue(unsigned char x, unsigned char min_val, unsigned char  max_val);
-		bool bgr24ToYuv420p(unsigned char* bgrBuf, int w, int h, unsigned char* yuvBuf);
+		//编码后的视频帧，容量为1秒
+		BlockingQueue <AVPacket> mVideoPktQ;
+
+		// 推流阶段的状态，只在执行该阶段的线程中使用 start
+		bool initEncode();
+		void releaseEncode();
+		AVFrame*  mEncodeFrame = NULL;    // 送入编码器的yuv420p帧
+		uint8_t*  mEncodeFrameBuff = NULL;// bgr帧转换为yuv420p时使用
+		AVPacket* mEncodePkt = NULL;      // 编码后的视频帧
+		int64_t   mEncodeFrameCount = 0;
+		// 推流阶段的状态 end
 	};
 
 }
@@ -0,0 +1,82 @@
+﻿#include "CheckRateController.h"
+#include "Scheduler.h"
+#include "Config.h"
+#include "Control.h"
+
+namespace AVSAnalyzer {
+    CheckRateController::CheckRateController(Scheduler* scheduler, Control* control) :
+        mScheduler(scheduler),
+        mControl(control)
+    {
+        Config* config = scheduler->getConfig();
+        mTargetFps = control->targetCheckFps >= 0 ? control->targetCheckFps : config->defaultTargetCheckFps;
+        if (mTargetFps < 0) {
+            mTargetFps = 0;
+        }
+        if (mTargetFps <= 0 && config->checkFpsBudget > 0) {
+            // 有全局预算时不限制的布控按视频帧率计入预算，否则会绕过预算
+            mTargetFps = control->videoFps > 0 ? control->videoFps : 25;
+        }
+        mBoostFactor = config->checkBoostFactor > 1 ? config->checkBoostFactor : 1;
+        mBoostMs = config->checkBoostMs;
+
+        mControl->targetCheckFps = mTargetFps;
+        mScheduler->addCheckFpsTarget(mTargetFps);
+    }
+
+    CheckRateController::~CheckRateController()
+    {
+        mScheduler->removeCheckFpsTarget(mTargetFps + mBoostFps);
+    }
+
+    float CheckRateController::getEffectiveFps(int64_t now) {
+        if (mBoostFps > 0 && now >= mBoostUntil) {
+            mScheduler->removeCheckFpsTarget(mBoostFps);
+            mBoostFps = 0;
+        }
+        // 提高的帧率也计入全局预算，所有布控的检测帧率之和不超过预算
+        float fps = (mTargetFps + mBoostFps) * mScheduler->getCheckFpsScale();
+        float budget = mScheduler->getConfig()->checkFpsBudget;
+        if (budget > 0 && fps > budget) {
+            fps = budget;
+        }
+        return fps;
+    }
+
+    bool CheckRateController::isDue(int64_t now) {
+        if (mTargetFps <= 0) {
+            return true;
+        }
+        return now >= mNextCheckTime;
+    }
+
+    void CheckRateController::consume(int64_t now) {
+        if (mTargetFps <= 0) {
+            return;
+        }
+        float fps = getEffectiveFps(now);
+        mControl->effectiveCheckFps = fps;
+
+        int64_t interval = fps > 0 ? int64_t(1000 / fps) : 1000;
+        // 落后超过一个间隔时重新对齐，不补发检测
+        if (mNextCheckTime + interval < now) {
+            mNextCheckTime = now;
+        }
+        mNextCheckTime += interval;
+    }
+
+    void CheckRateController::boost(int64_t now) {
+        if (mTargetFps > 0 && mBoostMs > 0 && mBoostFactor > 1) {
+            mBoostUntil = now + mBoostMs;
+            if (mBoostFps <= 0) {
+                mBoostFps = mTargetFps * (mBoostFactor - 1);
+                mScheduler->addCheckFpsTarget(mBoostFps);
+            }
+            // 立即按提高后的帧率计算下一次检测时间
+            int64_t interval = int64_t(1000 / getEffectiveFps(now));
+            if (mNextCheckTime > now + interval) {
+                mNextCheckTime = now + interval;
+            }
+        }
+    }
+}
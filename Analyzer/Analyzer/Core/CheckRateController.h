@@ -0,0 +1,37 @@
+﻿#ifndef ANALYZER_CHECKRATECONTROLLER_H
+#define ANALYZER_CHECKRATECONTROLLER_H
+#include <stdint.h>
+
+namespace AVSAnalyzer {
+	class Scheduler;
+	struct Control;
+
+	/*
+	单路布控的算法检测节奏：
+	按目标检测帧率（targetCheckFps）均匀提交检测帧，
+	所有布控的目标帧率之和超过全局预算（checkFpsBudget）时按比例降低，
+	检测到目标后的一段时间内提高检测帧率，提高的部分同样计入预算
+	*/
+	class CheckRateController
+	{
+	public:
+		CheckRateController(Scheduler* scheduler, Control* control);
+		~CheckRateController();
+	public:
+		bool isDue(int64_t now);  // 是否到了下一次检测的时间
+		void consume(int64_t now);// 已提交检测，计算下一次检测的时间
+		void boost(int64_t now);  // 检测到目标
+	private:
+		float getEffectiveFps(int64_t now);
+
+		Scheduler* mScheduler;
+		Control*   mControl;
+		float   mTargetFps;        // 目标检测帧率，0表示不限制
+		float   mBoostFactor;
+		int     mBoostMs;
+		int64_t mNextCheckTime = 0;
+		int64_t mBoostUntil = 0;
+		float   mBoostFps = 0;         // 提高检测帧率期间额外计入全局预算的帧率
+	};
+}
+#endif //ANALYZER_CHECKRATECONTROLLER_H
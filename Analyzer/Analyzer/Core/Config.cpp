@@ -27,6 +27,156 @@ namespace AVSAnalyzer {
                 this->controlExecutorMaxNum = root["controlExecutorMaxNum"].asInt();
                 this->supportHardwareVideoDecode = root["supportHardwareVideoDecode"].asBool();
                 this->supportHardwareVideoEncode = root["supportHardwareVideoEncode"].asBool();
+                if (root["hardwareVideoDecoder"].isString()) {
+                    this->hardwareVideoDecoder = root["hardwareVideoDecoder"].asString();
+                }
+                if (root["videoDecodeThreads"].isInt()) {
+                    this->videoDecodeThreads = root["videoDecodeThreads"].asInt();
+                }
+                if (root["videoDecodeThreadType"].isString()) {
+                    this->videoDecodeThreadType = root["videoDecodeThreadType"].asString();
+                }
+                if (root["videoDecodeThreadBudget"].isInt()) {
+                    this->videoDecodeThreadBudget = root["videoDecodeThreadBudget"].asInt();
+                }
+                if (root["schedulerTickMs"].isInt()) {
+                    this->schedulerTickMs = root["schedulerTickMs"].asInt();
+                }
+                if (root["stageWorkerNum"].isInt()) {
+                    this->stageWorkerNum = root["stageWorkerNum"].asInt();
+                }
+                if (root["stageMaxItemsPerRun"].isInt()) {
+                    this->stageMaxItemsPerRun = root["stageMaxItemsPerRun"].asInt();
+                }
+                if (root["reducedDecodeFullMs"].isInt()) {
+                    this->reducedDecodeFullMs = root["reducedDecodeFullMs"].asInt();
+                }
+                if (root["alarmVideoMode"].isString()) {
+                    this->alarmVideoMode = root["alarmVideoMode"].asString();
+                }
+                if (root["alarmPreSeconds"].isInt()) {
+                    this->alarmPreSeconds = root["alarmPreSeconds"].asInt();
+                }
+                if (root["alarmVideoSeconds"].isInt()) {
+                    this->alarmVideoSeconds = root["alarmVideoSeconds"].asInt();
+                }
+                if (root["alarmImagePoolBudgetMB"].isInt()) {
+                    this->alarmImagePoolBudgetMB = root["alarmImagePoolBudgetMB"].asInt();
+                }
+                if (root["alarmWorkerNum"].isInt()) {
+                    this->alarmWorkerNum = root["alarmWorkerNum"].asInt();
+                }
+                if (root["alarmQueueCapacity"].isInt()) {
+                    this->alarmQueueCapacity = root["alarmQueueCapacity"].asInt();
+                }
+                if (root["alarmEncodeThreads"].isInt()) {
+                    this->alarmEncodeThreads = root["alarmEncodeThreads"].asInt();
+                }
+                if (root["alarmSpill"].isBool()) {
+                    this->alarmSpill = root["alarmSpill"].asBool();
+                }
+                if (root["alarmSpillThresholdMB"].isInt()) {
+                    this->alarmSpillThresholdMB = root["alarmSpillThresholdMB"].asInt();
+                }
+                if (root["alarmSpillSegmentMB"].isInt()) {
+                    this->alarmSpillSegmentMB = root["alarmSpillSegmentMB"].asInt();
+                }
+                if (root["alarmSpillMaxMB"].isInt()) {
+                    this->alarmSpillMaxMB = root["alarmSpillMaxMB"].asInt();
+                }
+                if (root["videoFramePoolCapacity"].isInt()) {
+                    this->videoFramePoolCapacity = root["videoFramePoolCapacity"].asInt();
+                }
+                if (root["videoPktQueueCapacity"].isInt()) {
+                    this->videoPktQueueCapacity = root["videoPktQueueCapacity"].asInt();
+                }
+                if (root["videoPktQueuePolicy"].isString()) {
+                    this->videoPktQueuePolicy = root["videoPktQueuePolicy"].asString();
+                }
+                if (root["pushFrameQueueCapacity"].isInt()) {
+                    this->pushFrameQueueCapacity = root["pushFrameQueueCapacity"].asInt();
+                }
+                if (root["pushFrameQueuePolicy"].isString()) {
+                    this->pushFrameQueuePolicy = root["pushFrameQueuePolicy"].asString();
+                }
+                if (root["alarmFrameQueueCapacity"].isInt()) {
+                    this->alarmFrameQueueCapacity = root["alarmFrameQueueCapacity"].asInt();
+                }
+                if (root["alarmFrameQueuePolicy"].isString()) {
+                    this->alarmFrameQueuePolicy = root["alarmFrameQueuePolicy"].asString();
+                }
+                // 这两个队列的生产者在共享的解码分析线程中执行，阻塞会拖慢其他布控
+                if (this->pushFrameQueuePolicy == "block") {
+                    LOGE("pushFrameQueuePolicy=block is not supported, use dropOldest");
+                    this->pushFrameQueuePolicy = "dropOldest";
+                }
+                if (this->alarmFrameQueuePolicy == "block") {
+                    LOGE("alarmFrameQueuePolicy=block is not supported, use dropOldest");
+                    this->alarmFrameQueuePolicy = "dropOldest";
+                }
+                if (root["algorithmInputSize"].isInt()) {
+                    this->algorithmInputSize = root["algorithmInputSize"].asInt();
+                }
+                if (root["algorithmApiMaxConnPerHost"].isInt()) {
+                    this->algorithmApiMaxConnPerHost = root["algorithmApiMaxConnPerHost"].asInt();
+                }
+                if (root["algorithmApiEjectErrors"].isInt()) {
+                    this->algorithmApiEjectErrors = root["algorithmApiEjectErrors"].asInt();
+                }
+                if (root["algorithmApiEjectBaseMs"].isInt()) {
+                    this->algorithmApiEjectBaseMs = root["algorithmApiEjectBaseMs"].asInt();
+                }
+                if (root["algorithmApiEjectMaxMs"].isInt()) {
+                    this->algorithmApiEjectMaxMs = root["algorithmApiEjectMaxMs"].asInt();
+                }
+                if (root["algorithmApiTransport"].isString()) {
+                    this->algorithmApiTransport = root["algorithmApiTransport"].asString();
+                }
+                if (root["algorithmWorkerNum"].isInt()) {
+                    this->algorithmWorkerNum = root["algorithmWorkerNum"].asInt();
+                }
+                if (root["algorithmMaxInFlight"].isInt()) {
+                    this->algorithmMaxInFlight = root["algorithmMaxInFlight"].asInt();
+                }
+                if (root["defaultTargetCheckFps"].isNumeric()) {
+                    this->defaultTargetCheckFps = root["defaultTargetCheckFps"].asFloat();
+                }
+                if (root["checkFpsBudget"].isNumeric()) {
+                    this->checkFpsBudget = root["checkFpsBudget"].asFloat();
+                }
+                if (root["checkBoostFactor"].isNumeric()) {
+                    this->checkBoostFactor = root["checkBoostFactor"].asFloat();
+                }
+                if (root["checkBoostMs"].isInt()) {
+                    this->checkBoostMs = root["checkBoostMs"].asInt();
+                }
+                if (root["motionMaxSkipMs"].isInt()) {
+                    this->motionMaxSkipMs = root["motionMaxSkipMs"].asInt();
+                }
+                if (root["algorithmBatchSize"].isInt()) {
+                    this->algorithmBatchSize = root["algorithmBatchSize"].asInt();
+                }
+                if (root["algorithmBatchWindowMs"].isInt()) {
+                    this->algorithmBatchWindowMs = root["algorithmBatchWindowMs"].asInt();
+                }
+                if (root["algorithmBackend"].isString()) {
+                    this->algorithmBackend = root["algorithmBackend"].asString();
+                }
+                if (root["algorithmOnnxModel"].isString()) {
+                    this->algorithmOnnxModel = root["algorithmOnnxModel"].asString();
+                }
+                if (root["algorithmOnnxInputSize"].isInt()) {
+                    this->algorithmOnnxInputSize = root["algorithmOnnxInputSize"].asInt();
+                }
+                if (root["algorithmOnnxConfThreshold"].isNumeric()) {
+                    this->algorithmOnnxConfThreshold = root["algorithmOnnxConfThreshold"].asFloat();
+                }
+                if (root["algorithmOnnxNmsThreshold"].isNumeric()) {
+                    this->algorithmOnnxNmsThreshold = root["algorithmOnnxNmsThreshold"].asFloat();
+                }
+                if (root["algorithmOnnxInstances"].isInt()) {
+                    this->algorithmOnnxInstances = root["algorithmOnnxInstances"].asInt();
+                }
 
                 Json::Value algorithmApiHosts = root["algorithmApiHosts"];
                 for (auto& item : algorithmApiHosts) {
@@ -56,8 +206,36 @@ namespace AVSAnalyzer {
         printf("config.rootVideoDir=%s\n", rootVideoDir.data());
         printf("config.subVideoDirFormat=%s\n", subVideoDirFormat.data());
         printf("config.controlExecutorMaxNum=%d\n", controlExecutorMaxNum);
-        printf("config.supportHardwareVideoDecode=%d\n", supportHardwareVideoDecode);
+        printf("config.supportHardwareVideoDecode=%d,hardwareVideoDecoder=%s\n", supportHardwareVideoDecode, hardwareVideoDecoder.data());
+        printf("config.videoDecodeThreads=%d,videoDecodeThreadType=%s,videoDecodeThreadBudget=%d\n",
+            videoDecodeThreads, videoDecodeThreadType.data(), videoDecodeThreadBudget);
+        printf("config.schedulerTickMs=%d\n", schedulerTickMs);
+        printf("config.stageWorkerNum=%d,stageMaxItemsPerRun=%d\n", stageWorkerNum, stageMaxItemsPerRun);
+        printf("config.reducedDecodeFullMs=%d\n", reducedDecodeFullMs);
         printf("config.supportHardwareVideoEncode=%d\n", supportHardwareVideoEncode);
+        printf("config.videoFramePoolCapacity=%d\n", videoFramePoolCapacity);
+        printf("config.videoPktQueueCapacity=%d,videoPktQueuePolicy=%s\n", videoPktQueueCapacity, videoPktQueuePolicy.data());
+        printf("config.pushFrameQueueCapacity=%d,pushFrameQueuePolicy=%s\n", pushFrameQueueCapacity, pushFrameQueuePolicy.data());
+        printf("config.alarmFrameQueueCapacity=%d,alarmFrameQueuePolicy=%s\n", alarmFrameQueueCapacity, alarmFrameQueuePolicy.data());
+        printf("config.alarmVideoMode=%s,alarmPreSeconds=%d,alarmVideoSeconds=%d\n",
+            alarmVideoMode.data(), alarmPreSeconds, alarmVideoSeconds);
+        printf("config.alarmImagePoolBudgetMB=%d\n", alarmImagePoolBudgetMB);
+        printf("config.alarmWorkerNum=%d,alarmQueueCapacity=%d,alarmEncodeThreads=%d\n",
+            alarmWorkerNum, alarmQueueCapacity, alarmEncodeThreads);
+        printf("config.alarmSpill=%d,alarmSpillThresholdMB=%d,alarmSpillSegmentMB=%d,alarmSpillMaxMB=%d\n",
+            alarmSpill, alarmSpillThresholdMB, alarmSpillSegmentMB, alarmSpillMaxMB);
+        printf("config.algorithmInputSize=%d\n", algorithmInputSize);
+        printf("config.algorithmApiMaxConnPerHost=%d,algorithmApiTransport=%s\n", algorithmApiMaxConnPerHost, algorithmApiTransport.data());
+        printf("config.algorithmApiEjectErrors=%d,algorithmApiEjectBaseMs=%d,algorithmApiEjectMaxMs=%d\n",
+            algorithmApiEjectErrors, algorithmApiEjectBaseMs, algorithmApiEjectMaxMs);
+        printf("config.algorithmWorkerNum=%d,algorithmMaxInFlight=%d\n", algorithmWorkerNum, algorithmMaxInFlight);
+        printf("config.defaultTargetCheckFps=%.2f,checkFpsBudget=%.2f,checkBoostFactor=%.2f,checkBoostMs=%d\n",
+            defaultTargetCheckFps, checkFpsBudget, checkBoostFactor, checkBoostMs);
+        printf("config.motionMaxSkipMs=%d\n", motionMaxSkipMs);
+        printf("config.algorithmBatchSize=%d,algorithmBatchWindowMs=%d\n", algorithmBatchSize, algorithmBatchWindowMs);
+        printf("config.algorithmBackend=%s,algorithmOnnxModel=%s\n", algorithmBackend.data(), algorithmOnnxModel.data());
+        printf("config.algorithmOnnxInputSize=%d,algorithmOnnxConfThreshold=%.2f,algorithmOnnxNmsThreshold=%.2f,algorithmOnnxInstances=%d\n",
+            algorithmOnnxInputSize, algorithmOnnxConfThreshold, algorithmOnnxNmsThreshold, algorithmOnnxInstances);
 
         for (int i = 0; i < algorithmApiHosts.size(); i++)
         {
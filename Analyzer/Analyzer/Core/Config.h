@@ -24,9 +24,56 @@ namespace AVSAnalyzer {
 		std::string subVideoDirFormat{};
 		int  controlExecutorMaxNum = 0;// 支持的分析视频最大路数
 		bool supportHardwareVideoDecode = false;
+		std::string hardwareVideoDecoder = "cuvid";// 硬解码器后缀，与编码格式拼接为解码器名称 cuvid:英伟达独显 qsv:酷睿核显
+		int  videoDecodeThreads = 2;     // 布控未指定时每路软解码的线程数
+		std::string videoDecodeThreadType = "frame";// frame:帧级多线程（输出延迟增加线程数帧） slice:片级多线程 auto:两者
+		int  videoDecodeThreadBudget = 0;// 所有布控软解码线程数之和的上限，0表示cpu核数
+		int  schedulerTickMs = 1000;     // 调度器例行维护（刷新布控统计信息等）的周期（毫秒）
+		int  stageWorkerNum = 0;         // 所有布控共享的解码分析、报警、推流编码线程数，0表示cpu核数（推流写网络在每路布控自己的线程）
+		int  stageMaxItemsPerRun = 8;    // 每次调度一个布控阶段最多处理的数据个数
+		int  reducedDecodeFullMs = 10000;// 降低解码量的布控发生报警后完整解码的时长（毫秒）
 		bool supportHardwareVideoEncode = false;
+		int  videoFramePoolCapacity = 10;// 每路布控视频帧池的容量（帧数）
+		int  videoPktQueueCapacity = 250; // 未解码视频帧队列容量
+		std::string videoPktQueuePolicy = "dropNonKeyframe";// 队列满时的策略 dropOldest/dropNonKeyframe/block
+		int  pushFrameQueueCapacity = 4;  // 推流视频帧队列容量
+		std::string pushFrameQueuePolicy = "dropOldest";// dropOldest/dropNonKeyframe，生产者是解码分析线程，不支持block
+		int  alarmFrameQueueCapacity = 4; // 报警视频帧队列容量，不足视频帧率时按1秒的帧数
+		std::string alarmFrameQueuePolicy = "dropOldest";// 同pushFrameQueuePolicy
+		std::string alarmVideoMode = "remux";// 布控未指定时报警视频的生成方式 remux:缓存原始pkt直接封装 overlay:缓存绘制检测结果后的jpg并重新编码
+		int  alarmPreSeconds = 2;        // 报警视频包含事件发生前的时长（秒），remux时从该时长之前最近的关键帧开始
+		int  alarmVideoSeconds = 6;      // 报警视频的总时长（秒）
+		int  alarmImagePoolBudgetMB = 512;// 所有布控报警图片（jpg）占用内存的上限（MB），0表示不限制
+		int  alarmWorkerNum = 2;         // 生成报警视频的线程数
+		int  alarmQueueCapacity = 32;    // 待生成的报警数上限，超出时丢弃待生成报警最多的布控中最早的报警
+		int  alarmEncodeThreads = 0;     // 每个报警视频编码使用的线程数，0表示cpu核数/alarmWorkerNum
+		bool alarmSpill = false;         // 待生成报警的图片是否落盘到rootVideoDir/spill（内存映射的分段文件）
+		int  alarmSpillThresholdMB = 256;// 图片池使用中的内存超过该值（MB）时新的报警落盘，0表示总是落盘
+		int  alarmSpillSegmentMB = 256;  // 每个落盘分段文件的大小（MB），单个报警超过该值时不落盘
+		int  alarmSpillMaxMB = 4096;     // 所有落盘分段文件的总大小上限（MB），0表示不限制
+		int  algorithmInputSize = 640;   // 送入算法的图像长边像素，大于该值时等比缩小，0表示使用原图
 
 		std::vector<std::string> algorithmApiHosts;// 算法服务地址数组
+		int  algorithmApiMaxConnPerHost = 8;// 每个算法服务地址最多同时使用的连接数
+		int  algorithmApiEjectErrors = 3;     // 算法服务地址连续失败多少次后暂时摘除
+		int  algorithmApiEjectBaseMs = 1000;  // 首次摘除的时长（毫秒），之后每次翻倍
+		int  algorithmApiEjectMaxMs = 30000;  // 摘除的最大时长（毫秒）
+		std::string algorithmApiTransport = "binary";// 图片上传方式 binary:二进制jpg json:base64编码的jpg
+		int  algorithmWorkerNum = 8;   // 所有布控共享的算法检测线程数
+		int  algorithmMaxInFlight = 2; // 每路布控同时在检测中的最大帧数
+		int  algorithmBatchSize = 8;   // 多路布控的检测帧合并为一次请求的最大帧数，1表示不合并
+		int  algorithmBatchWindowMs = 5;// 收集一批检测帧最多等待的时间（毫秒）
+		std::string algorithmBackend = "api";// 布控未指定时使用的检测算法 api:算法服务 onnx:进程内onnx模型
+		std::string algorithmOnnxModel;      // onnx模型文件路径（yolov5导出格式），为空时不加载
+		int   algorithmOnnxInputSize = 640;  // onnx模型的输入尺寸
+		float algorithmOnnxConfThreshold = 0.25;// 置信度阈值
+		float algorithmOnnxNmsThreshold = 0.45; // nms的iou阈值
+		int   algorithmOnnxInstances = 2;    // 加载的模型实例数，即onnx同时检测的最大帧数
+		float defaultTargetCheckFps = 5; // 布控未指定时的目标检测帧率，0表示不限制
+		float checkFpsBudget = 0;        // 所有布控检测帧率之和的上限，0表示不限制；设置后不限制检测帧率的布控按视频帧率计入
+		float checkBoostFactor = 2;      // 检测到目标后检测帧率的倍数
+		int   checkBoostMs = 3000;       // 检测到目标后提高检测帧率的时长（毫秒）
+		int   motionMaxSkipMs = 10000;   // 画面没有变化时连续跳过检测的最长时间（毫秒），超过后强制检测一次
 
 
 	};
@@ -2,6 +2,7 @@
 #define ANALYZER_CONTROL_H
 
 #include <string>
+#include <vector>
 
 namespace AVSAnalyzer {
 	struct Control
@@ -12,19 +13,54 @@ namespace AVSAnalyzer {
 		std::string streamUrl;
 		bool        pushStream = false;
 		std::string pushStreamUrl;
+		bool        pushYuvDirect = true;// 推流时直接在解码后的yuv帧上绘制并编码，不经过bgr转换
 		std::string behaviorCode;
+		int         algorithmInputSize = -1;// 送入算法的图像长边像素，-1使用配置，0使用原图
+		int         algorithmMaxInFlight = 0;// 同时在检测中的最大帧数，0使用配置
+		std::string algorithmBackend;// 检测算法 api:算法服务 onnx:进程内onnx模型，为空使用配置
+		float       targetCheckFps = -1;// 目标检测帧率，-1使用配置，0表示不限制
+		bool        motionGate = true;  // 画面没有变化时跳过检测，沿用上一次的检测结果
+		int         motionThreshold = 12;  // 8x8像素块亮度平均值变化超过该值认为块发生了变化
+		float       motionRatio = 0.002f;  // 变化的块占比达到该值认为画面发生了变化
+		std::vector<float> motionMaskRegions;// 不参与变化判断的区域（如时间水印），每4个值为归一化坐标 x1,y1,x2,y2
+		int         decodeThreads = -1;// 软解码线程数，-1使用配置
+		std::string decodeSkipMode = "auto";// auto:不推流时同loopFilter none:完整解码 loopFilter:跳过环路滤波 nonref:跳过环路滤波和非参考帧
+		std::string decodeMode = "full";// full:解码所有帧 keyframe:只解码关键帧 gop:每decodeGopInterval个GOP解码一个，推流时始终为full
+		int         decodeGopInterval = 2;
+		std::string pullMode = "auto";// 拉流节奏 auto:点播按时间戳读取，直播尽快读取; realtime:始终按时间戳读取; fast:尽可能快地读取（离线分析）
 
 		int64_t alarmMinInterval = 30;// 同一布控最小的报警间隔时间（单位毫秒）
+		std::string alarmVideoMode;// 报警视频的生成方式 remux:原始pkt直接封装 overlay:绘制检测结果后重新编码，为空使用配置
 
 	public:
 		// 通过计算获得的参数
 		int64_t executorStartTimestamp = 0;// 执行器启动时毫秒级时间戳（13位）
-		float   checkFps = 0;// 算法检测的帧率（每秒检测的次数）
+		float   checkFps = 0;// 实际的算法检测帧率（每秒检测的次数）
+		float   effectiveCheckFps = 0;// 经过全局预算和检测后提速调整的检测帧率
 		int     videoWidth = 0;  // 布控视频流的像素宽
 		int     videoHeight = 0; // 布控视频流的像素高
 		int     videoChannel = 0;
 		int     videoIndex = -1;
 		int     videoFps = 0;
+		std::string videoDecoder;   // 实际使用的解码器名称
+		int     videoDecodeThreads = 0;// 从全局预算中分配到的解码线程数
+		int64_t decodeSkipPktCount = 0;// 降低解码量而未解码的pkt数
+		int     checkWidth = 0;  // 送入算法的图像像素宽
+		int     checkHeight = 0; // 送入算法的图像像素高
+		int     framePoolCapacity = 0;  // 视频帧池容量
+		int64_t framePoolHits = 0;      // 视频帧池命中次数
+		int64_t framePoolMisses = 0;    // 视频帧池未命中（新分配内存）次数
+		int     framePoolHighWater = 0; // 视频帧池同时使用帧数的最大值
+		int     videoPktQSize = 0;        // 未解码视频帧队列长度
+		int64_t videoPktQDropCount = 0;   // 未解码视频帧队列丢弃数
+		int     pushFrameQSize = 0;       // 推流视频帧队列长度
+		int64_t pushFrameQDropCount = 0;  // 推流视频帧队列丢弃数
+		int     alarmFrameQSize = 0;      // 报警视频帧队列长度
+		int64_t alarmFrameQDropCount = 0; // 报警视频帧队列丢弃数
+		int     checkInFlight = 0;        // 正在检测中的帧数
+		int64_t checkSkipCount = 0;       // 达到检测中帧数上限而跳过检测的次数
+		int64_t checkLatency = 0;         // 最近一次检测的耗时（毫秒）
+		int64_t motionSkipCount = 0;      // 画面没有变化而跳过检测的次数
 
 	public:
 
@@ -33,6 +69,34 @@ namespace AVSAnalyzer {
 				result_msg = "validate parameter error";
 				return false;
 			}
+			if (motionMaskRegions.size() % 4 != 0) {
+				result_msg = "validate parameter motionMaskRegions is error";
+				return false;
+			}
+			if (!algorithmBackend.empty() && algorithmBackend != "api" && algorithmBackend != "onnx") {
+				result_msg = "validate parameter algorithmBackend is error: " + algorithmBackend;
+				return false;
+			}
+			if (decodeSkipMode != "auto" && decodeSkipMode != "none" && decodeSkipMode != "loopFilter" && decodeSkipMode != "nonref") {
+				result_msg = "validate parameter decodeSkipMode is error: " + decodeSkipMode;
+				return false;
+			}
+			if (decodeMode != "full" && decodeMode != "keyframe" && decodeMode != "gop") {
+				result_msg = "validate parameter decodeMode is error: " + decodeMode;
+				return false;
+			}
+			if (decodeMode == "gop" && decodeGopInterval < 1) {
+				result_msg = "validate parameter decodeGopInterval is error";
+				return false;
+			}
+			if (!alarmVideoMode.empty() && alarmVideoMode != "remux" && alarmVideoMode != "overlay") {
+				result_msg = "validate parameter alarmVideoMode is error: " + alarmVideoMode;
+				return false;
+			}
+			if (pullMode != "auto" && pullMode != "realtime" && pullMode != "fast") {
+				result_msg = "validate parameter pullMode is error: " + pullMode;
+				return false;
+			}
 			if (pushStream) {
 				if (pushStreamUrl.empty()) {
 					result_msg = "validate parameter pushStreamUrl is error: " + pushStreamUrl;
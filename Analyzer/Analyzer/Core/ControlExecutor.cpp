@@ -7,6 +7,9 @@
 #include "AvPullStream.h"
 #include "AvPushStream.h"
 #include "GenerateAlarm.h"
+#include "VideoFramePool.h"
+#include "Config.h"
+#include "StageExecutor.h"
 
 extern "C" {
 #include "libswscale/swscale.h"
@@ -22,7 +25,15 @@ namespace AVSAnalyzer {
         mPushStream(nullptr),
         mGenerateAlarm(nullptr),
         mAnalyzer(nullptr),
-        mState(false)
+        mVideoFramePool(nullptr),
+        mYuvFramePool(nullptr),
+        mCheckFramePool(nullptr),
+        mStageExecutor(nullptr),
+        mDecodeStage(nullptr),
+        mAlarmStage(nullptr),
+        mPushStage(nullptr),
+        mState(false),
+        mDecodeCtx(nullptr)
     {
         mControl->executorStartTimestamp = getCurTimestamp();
 
@@ -36,6 +47,10 @@ namespace AVSAnalyzer {
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
         mState = false;// 将执行状态设置为false
+        if (mPullStream) {
+            // 非直播流的读取线程可能一直阻塞在已满的队列上
+            mPullStream->stopVideoPktQueue();
+        }
 
         for (auto th : mThreads) {
             th->join();
@@ -47,6 +62,23 @@ namespace AVSAnalyzer {
         }
         mThreads.clear();
 
+        // 读取线程已退出，按数据流向依次移除阶段，之后不会再有阶段被调度
+        if (mDecodeStage) {
+            mStageExecutor->remove(mDecodeStage);
+            delete mDecodeStage;
+            mDecodeStage = nullptr;
+        }
+        if (mPushStage) {
+            mStageExecutor->remove(mPushStage);
+            delete mPushStage;
+            mPushStage = nullptr;
+        }
+        if (mAlarmStage) {
+            mStageExecutor->remove(mAlarmStage);
+            delete mAlarmStage;
+            mAlarmStage = nullptr;
+        }
+        releaseDecode();
 
         if (mPullStream) {
             delete mPullStream;
@@ -67,12 +99,36 @@ namespace AVSAnalyzer {
             mGenerateAlarm = nullptr;
         }
 
+        // 帧池最后释放，确保推流和报警队列中的帧已经归还
+        if (mVideoFramePool) {
+            delete mVideoFramePool;
+            mVideoFramePool = nullptr;
+        }
+        if (mYuvFramePool) {
+            delete mYuvFramePool;
+            mYuvFramePool = nullptr;
+        }
+        if (mCheckFramePool) {
+            delete mCheckFramePool;
+            mCheckFramePool = nullptr;
+        }
+
         if (mControl) {
+            if (mControl->videoDecodeThreads > 0) {
+                mScheduler->releaseDecodeThreads(mControl->videoDecodeThreads);
+            }
             delete mControl;
             mControl = nullptr;
         }
     }
     bool ControlExecutor::start(std::string& msg) {
+        int decodeThreads = mControl->decodeThreads >= 0 ? mControl->decodeThreads : mScheduler->getConfig()->videoDecodeThreads;
+        mControl->videoDecodeThreads = mScheduler->acquireDecodeThreads(decodeThreads);
+        std::string backend = mControl->algorithmBackend.empty() ? mScheduler->getConfig()->algorithmBackend : mControl->algorithmBackend;
+        if (backend == "onnx" && !mScheduler->getOnnxAlgorithm()) {
+            msg = "onnx model is not loaded";
+            return false;
+        }
 
         this->mPullStream = new AvPullStream(mScheduler->getConfig(), mControl);
         if (this->mPullStream->connect()) {
@@ -95,27 +151,43 @@ namespace AVSAnalyzer {
             return false;
         }
 
+        // yuv帧供推流和报警共享；bgr帧只在推流不使用yuv时才转换
+        this->mYuvFramePool = new VideoFramePool(VideoFrame::YUV420P, mControl->videoWidth, mControl->videoHeight,
+            mScheduler->getConfig()->videoFramePoolCapacity);
+        this->mVideoFramePool = new VideoFramePool(VideoFrame::BGR, mControl->videoWidth, mControl->videoHeight,
+            mScheduler->getConfig()->pushFrameQueueCapacity + 2);
+        initCheckSize();
+        // 推流需要每一帧，不能降低解码量
+        mReducedDecode = "full" != mControl->decodeMode && !mControl->pushStream;
+        // 检测中的帧和正在转换的帧都来自该帧池
+        int maxInFlight = mControl->algorithmMaxInFlight > 0 ? mControl->algorithmMaxInFlight : mScheduler->getConfig()->algorithmMaxInFlight;
+        this->mCheckFramePool = new VideoFramePool(VideoFrame::BGR, mControl->checkWidth, mControl->checkHeight, maxInFlight + 1);
         this->mAnalyzer = new Analyzer(mScheduler, mControl);
-        this->mGenerateAlarm = new GenerateAlarm(mScheduler->getConfig(), mControl);
+        this->mGenerateAlarm = new GenerateAlarm(mScheduler, mControl);
+
+        // 解码分析、报警、推流由共享的阶段线程池执行，输入队列有数据时调度
+        initDecode();
+        mStageExecutor = mScheduler->getStageExecutor();
+        mDecodeStage = new Stage("decode", ControlExecutor::decodeAndAnalyzeVideo, ControlExecutor::hasVideoPkt, this);
+        mAlarmStage = new Stage("alarm", GenerateAlarm::generateAlarm, GenerateAlarm::hasVideoFrame, this);
+        mPullStream->setVideoPktNotify([this] { mStageExecutor->schedule(mDecodeStage); });
+        mGenerateAlarm->setVideoFrameNotify([this] { mStageExecutor->schedule(mAlarmStage); });
+        if (mControl->pushStream) {
+            if (mControl->videoIndex > -1) {
+                mPushStage = new Stage("push", AvPushStream::encodeVideoFrame, AvPushStream::hasVideoFrame, this);
+                mPushStream->setVideoFrameNotify([this] { mStageExecutor->schedule(mPushStage); });
+            }
+        }
 
         mState = true;// 将执行状态设置为true
 
-
+        // av_read_frame会阻塞，拉流仍然使用单独的线程
         std::thread* th = new std::thread(AvPullStream::readThread, this);
         mThreads.push_back(th);
-
-        th = new std::thread(ControlExecutor::decodeAndAnalyzeVideoThread, this);
-        mThreads.push_back(th);
-
-        th = new std::thread(GenerateAlarm::generateAlarmThread, this);
-        mThreads.push_back(th);
-
-
-        if (mControl->pushStream) {
-            if (mControl->videoIndex > -1) {
-                th = new std::thread(AvPushStream::encodeVideoAndWriteStreamThread, this);
-                mThreads.push_back(th);
-            }
+        // 写网络最长会阻塞到rw_timeout，每路推流使用自己的写入线程，推流服务变慢时不影响其他布控
+        if (mPushStage) {
+            th = new std::thread(AvPushStream::writeVideoPktThread, this);
+            mThreads.push_back(th);
         }
 
         for (auto th : mThreads) {
@@ -135,125 +207,364 @@ namespace AVSAnalyzer {
         this->mScheduler->removeExecutor(mControl);
     }
 
-    void ControlExecutor::decodeAndAnalyzeVideoThread(void* arg) {
+    bool ControlExecutor::needDecodeVideoPkt(const AVPacket& pkt) {
+        if (!mReducedDecode) {
+            return true;
+        }
+        // 只在关键帧处切换，GOP中间开始解码会因为缺少参考帧而花屏
+        if (pkt.flags & AV_PKT_FLAG_KEY) {
+            if (getCurTime() < mFullDecodeUntil) {
+                mGopDecoding = true;
+            }
+            else if ("gop" == mControl->decodeMode) {
+                mGopDecoding = (mGopIndex % mControl->decodeGopInterval) == 0;
+            }
+            else {
+                mGopDecoding = false;
+            }
+            mGopIndex++;
+            if (mGopDecoding || "keyframe" == mControl->decodeMode) {
+                return true;
+            }
+        }
+        else if (mGopDecoding) {
+            return true;
+        }
+        mControl->decodeSkipPktCount++;
+        return false;
+    }
+
+    void ControlExecutor::updateStats() {
 
-        ControlExecutor* executor = (ControlExecutor*)arg;
-        int width = executor->mPullStream->mVideoCodecCtx->width;
-        int height = executor->mPullStream->mVideoCodecCtx->height;
+        mYuvFramePool->getStats(mControl->framePoolCapacity,
+            mControl->framePoolHits,
+            mControl->framePoolMisses,
+            mControl->framePoolHighWater);
 
-        AVPacket pkt; // 未解码的视频帧
-        int      pktQSize = 0; // 未解码视频帧队列当前长度
+        mPullStream->getVideoPktQueueStats(mControl->videoPktQSize, mControl->videoPktQDropCount);
+        if (mPushStream) {
+            mPushStream->getVideoFrameQueueStats(mControl->pushFrameQSize, mControl->pushFrameQDropCount);
+        }
+        mGenerateAlarm->getVideoFrameQueueStats(mControl->alarmFrameQSize, mControl->alarmFrameQDropCount);
+        mAnalyzer->getInferenceStats(mControl->checkInFlight, mControl->checkSkipCount, mControl->checkLatency,
+            mControl->motionSkipCount);
+    }
 
-        AVFrame* frame_yuv420p = av_frame_alloc();// pkt->解码->frame
-        AVFrame* frame_bgr = av_frame_alloc();
+    void ControlExecutor::initCheckSize() {
+        int inputSize = mControl->algorithmInputSize;
+        if (inputSize < 0) {
+            inputSize = mScheduler->getConfig()->algorithmInputSize;
+        }
 
-        int frame_bgr_buff_size = av_image_get_buffer_size(AV_PIX_FMT_BGR24, width, height, 1);
-        uint8_t* frame_bgr_buff = (uint8_t*)av_malloc(frame_bgr_buff_size);
-        av_image_fill_arrays(frame_bgr->data, frame_bgr->linesize, frame_bgr_buff, AV_PIX_FMT_BGR24, width, height, 1);
+        int width = mControl->videoWidth;
+        int height = mControl->videoHeight;
+        int longSide = width > height ? width : height;
 
-        SwsContext* sws_ctx_yuv420p2bgr = sws_getContext(width, height,
-            executor->mPullStream->mVideoCodecCtx->pix_fmt,
-            executor->mPullStream->mVideoCodecCtx->width,
-            executor->mPullStream->mVideoCodecCtx->height,
-            AV_PIX_FMT_BGR24,
-            SWS_BICUBIC, nullptr, nullptr, nullptr);
+        if (inputSize > 0 && longSide > inputSize) {
+            // 等比缩小，宽高保持为偶数
+            mControl->checkWidth = (int)((int64_t)width * inputSize / longSide) & ~1;
+            mControl->checkHeight = (int)((int64_t)height * inputSize / longSide) & ~1;
+            if (mControl->checkWidth < 2) {
+                mControl->checkWidth = 2;
+            }
+            if (mControl->checkHeight < 2) {
+                mControl->checkHeight = 2;
+            }
+        }
+        else {
+            mControl->checkWidth = width;
+            mControl->checkHeight = height;
+        }
+        LOGI("video=%dx%d,algorithmInputSize=%d,check=%dx%d", width, height, inputSize,
+            mControl->checkWidth, mControl->checkHeight);
+    }
+
+    // 解码分析阶段的状态，只在执行该阶段的线程中使用
+    struct VideoDecodeContext
+    {
+        int width = 0;
+        int height = 0;
+
+        AVFrame* frame_yuv420p = nullptr;// pkt->解码->frame
+        AVFrame* frame_bgr = nullptr;
+        AVFrame* frame_check_bgr = nullptr;
+        AVFrame* frame_share_yuv420p = nullptr;
 
-        int fps = executor->mControl->videoFps;
+        int  checkWidth = 0;
+        int  checkHeight = 0;
+        bool pushBgr = false;// 推流不使用yuv时，每帧都需要bgr
+
+        SwsContext* sws_ctx_yuv420p2bgr = nullptr;
+        SwsContext* sws_ctx_decode2check = nullptr;  // 算法输入缩小时，转换bgr和缩放一次完成
+        SwsContext* sws_ctx_check = nullptr;
+        SwsContext* sws_ctx_decode2yuv420p = nullptr;// 解码格式不是yuv420p时使用
 
         //算法检测参数start
-        bool cur_is_check = false;// 当前帧是否进行算法检测
         int  continuity_check_count = 0;// 当前连续进行算法检测的帧数
         int  continuity_check_max_time = 3000;//连续进行算法检测，允许最长的时间。单位毫秒
-        int64_t continuity_check_start = getCurTime();//单位毫秒
-        int64_t continuity_check_end = 0;
+        int64_t continuity_check_start = 0;//单位毫秒
         //算法检测参数end
 
-        int ret = -1;
         int64_t frameCount = 0;
-        while (executor->getState())
-        {
-            if (executor->mPullStream->getVideoPkt(pkt, pktQSize)) {
-
-                if (executor->mControl->videoIndex > -1) {
-
-                    ret = avcodec_send_packet(executor->mPullStream->mVideoCodecCtx, &pkt);
-                    if (ret == 0) {
-                        ret = avcodec_receive_frame(executor->mPullStream->mVideoCodecCtx, frame_yuv420p);
-
-                        if (ret == 0) {
-                            frameCount++;
-
-                            // frame（yuv420p） 转 frame_bgr
-                            sws_scale(sws_ctx_yuv420p2bgr,
-                                frame_yuv420p->data, frame_yuv420p->linesize, 0, height,
-                                frame_bgr->data, frame_bgr->linesize);
-
-                            if (pktQSize == 0) {
-                                cur_is_check = true;
-                            }
-                            else {
-                                cur_is_check = false;
-                            }
-
-                            if (cur_is_check) {
-                                continuity_check_count += 1;
-                            }
-
-                            continuity_check_end = getCurTime();
-                            if (continuity_check_end - continuity_check_start > continuity_check_max_time) {
-                                executor->mControl->checkFps = float(continuity_check_count) / (float(continuity_check_end - continuity_check_start) / 1000);
-                                continuity_check_count = 0;
-                                continuity_check_start = getCurTime();
-                            }
-
-                            float happenScore;
-                            bool happen = executor->mAnalyzer->checkVideoFrame(cur_is_check, frameCount, frame_bgr->data[0], happenScore);
-                            //executor->mAnalyzer->SDLShow(frame_bgr->data[0]);
-                            //executor->mAnalyzer->SDLShow(frame_yuv420p->linesize, frame_yuv420p->data);
-
-
-                            //LOGI("decode 1 frame frameCount=%lld,pktQSize=%d,fps=%d,check=%d,checkFps=%f",
-                            //    frameCount, pktQSize, fps, check, executor->mControl->checkFps);
-
-                            if (executor->mControl->pushStream) {
-                                executor->mPushStream->pushVideoFrame(frame_bgr->data[0], frame_bgr_buff_size);
-                            }
-                            executor->mGenerateAlarm->pushVideoFrame(frame_bgr->data[0], frame_bgr_buff_size, happen, happenScore);
-                        }
-                        else {
-                            LOGE("avcodec_receive_frame error : ret=%d", ret);
-                        }
-                    }
-                    else {
-                        LOGE("avcodec_send_packet error : ret=%d", ret);
-                    }
+        bool    happen = false;// 最近一次解码帧的检测结果，remux报警时用于标记pkt
+    };
+
+    void ControlExecutor::initDecode() {
+        VideoDecodeContext* ctx = new VideoDecodeContext;
+        int width = mPullStream->mVideoCodecCtx->width;
+        int height = mPullStream->mVideoCodecCtx->height;
+        ctx->width = width;
+        ctx->height = height;
+
+        ctx->frame_yuv420p = av_frame_alloc();
+        ctx->frame_bgr = av_frame_alloc();
+
+        ctx->checkWidth = mControl->checkWidth;
+        ctx->checkHeight = mControl->checkHeight;
+        bool checkFullSize = (ctx->checkWidth == width && ctx->checkHeight == height);
+
+        ctx->pushBgr = mControl->pushStream && !mControl->pushYuvDirect;
+
+        AVPixelFormat decode_pix_fmt = mPullStream->mVideoCodecCtx->pix_fmt;
+        ctx->sws_ctx_yuv420p2bgr = sws_getContext(width, height,
+            decode_pix_fmt,
+            width,
+            height,
+            AV_PIX_FMT_BGR24,
+            SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+        ctx->frame_check_bgr = av_frame_alloc();
+        if (!checkFullSize) {
+            ctx->sws_ctx_decode2check = sws_getContext(width, height, decode_pix_fmt,
+                ctx->checkWidth, ctx->checkHeight, AV_PIX_FMT_BGR24,
+                SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+        }
+        ctx->sws_ctx_check = checkFullSize ? ctx->sws_ctx_yuv420p2bgr : ctx->sws_ctx_decode2check;
+
+        // 解码格式为yuv420p时只复制平面，否则转换为yuv420p
+        ctx->frame_share_yuv420p = av_frame_alloc();
+        if (AV_PIX_FMT_YUV420P != decode_pix_fmt && AV_PIX_FMT_YUVJ420P != decode_pix_fmt) {
+            ctx->sws_ctx_decode2yuv420p = sws_getContext(width, height, decode_pix_fmt,
+                width, height, AV_PIX_FMT_YUV420P,
+                SWS_BICUBIC, nullptr, nullptr, nullptr);
+        }
+
+        ctx->continuity_check_start = getCurTime();
+        mDecodeCtx = ctx;
+    }
+
+    void ControlExecutor::releaseDecode() {
+        VideoDecodeContext* ctx = mDecodeCtx;
+        if (!ctx) {
+            return;
+        }
+        mDecodeCtx = nullptr;
+
+        av_frame_free(&ctx->frame_yuv420p);
+        //av_frame_unref(frame_yuv420p);
+        ctx->frame_yuv420p = NULL;
+
+        av_frame_free(&ctx->frame_bgr);
+        //av_frame_unref(frame_bgr);
+        ctx->frame_bgr = NULL;
+
+        av_frame_free(&ctx->frame_share_yuv420p);
+        ctx->frame_share_yuv420p = NULL;
+
+        av_frame_free(&ctx->frame_check_bgr);
+        ctx->frame_check_bgr = NULL;
+
+        if (ctx->sws_ctx_decode2check) {
+            sws_freeContext(ctx->sws_ctx_decode2check);
+            ctx->sws_ctx_decode2check = NULL;
+        }
+
+        if (ctx->sws_ctx_decode2yuv420p) {
+            sws_freeContext(ctx->sws_ctx_decode2yuv420p);
+            ctx->sws_ctx_decode2yuv420p = NULL;
+        }
+
+        sws_freeContext(ctx->sws_ctx_yuv420p2bgr);
+        ctx->sws_ctx_yuv420p2bgr = NULL;
+
+        delete ctx;
+    }
+
+    bool ControlExecutor::hasVideoPkt(void* arg) {
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        return executor->mPullStream->hasVideoPkt();
+    }
+
+    void ControlExecutor::receiveVideoFrames(ControlExecutor* executor) {
+        VideoDecodeContext* ctx = executor->mDecodeCtx;
+        while (true) {
+            int ret = avcodec_receive_frame(executor->mPullStream->mVideoCodecCtx, ctx->frame_yuv420p);
+            if (ret != 0) {
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+                    LOGE("avcodec_receive_frame error : ret=%d", ret);
                 }
+                break;
+            }
+            analyzeVideoFrame(executor);
+        }
+    }
+
+    void ControlExecutor::analyzeVideoFrame(ControlExecutor* executor) {
+        VideoDecodeContext* ctx = executor->mDecodeCtx;
+        int width = ctx->width;
+        int height = ctx->height;
+
+        AVFrame* frame_yuv420p = ctx->frame_yuv420p;
+        AVFrame* frame_bgr = ctx->frame_bgr;
+        AVFrame* frame_check_bgr = ctx->frame_check_bgr;
+        AVFrame* frame_share_yuv420p = ctx->frame_share_yuv420p;
+
+        VideoFramePtr videoFrame;// 解码后的yuv420p帧，推流和报警共享同一份数据
+        VideoFramePtr bgrFrame;  // 推流使用的bgr帧
+        VideoFramePtr checkFrame;// 送入算法的bgr帧，异步检测期间不能被修改，单独从帧池获取
+
+        bool cur_is_check = false;// 当前帧是否进行算法检测
 
-                // 队列获取的pkt，必须释放!!!
-                //av_free_packet(&pkt);//过时
-                av_packet_unref(&pkt);
+        ctx->frameCount++;
+
+        // 从帧池获取共享帧，消费者处理完成后自动归还
+        videoFrame = executor->mYuvFramePool->gain();
+        av_image_fill_arrays(frame_share_yuv420p->data, frame_share_yuv420p->linesize,
+            videoFrame->data, AV_PIX_FMT_YUV420P, width, height, 1);
+        if (ctx->sws_ctx_decode2yuv420p) {
+            sws_scale(ctx->sws_ctx_decode2yuv420p,
+                frame_yuv420p->data, frame_yuv420p->linesize, 0, height,
+                frame_share_yuv420p->data, frame_share_yuv420p->linesize);
+        }
+        else {
+            av_image_copy_plane(frame_share_yuv420p->data[0], frame_share_yuv420p->linesize[0],
+                frame_yuv420p->data[0], frame_yuv420p->linesize[0], width, height);
+            av_image_copy_plane(frame_share_yuv420p->data[1], frame_share_yuv420p->linesize[1],
+                frame_yuv420p->data[1], frame_yuv420p->linesize[1], (width + 1) / 2, (height + 1) / 2);
+            av_image_copy_plane(frame_share_yuv420p->data[2], frame_share_yuv420p->linesize[2],
+                frame_yuv420p->data[2], frame_yuv420p->linesize[2], (width + 1) / 2, (height + 1) / 2);
+        }
+
+        // 按目标检测帧率提交检测，检测中的帧数达到上限或画面没有变化时跳过
+        if (executor->mAnalyzer->isCheckReady() &&
+            executor->mAnalyzer->isSceneChanged(videoFrame->data)) {
+            cur_is_check = true;
+        }
+        else {
+            cur_is_check = false;
+        }
+
+        if (cur_is_check) {
+            ctx->continuity_check_count += 1;
+        }
+
+        int64_t continuity_check_end = getCurTime();
+        if (continuity_check_end - ctx->continuity_check_start > ctx->continuity_check_max_time) {
+            executor->mControl->checkFps = float(ctx->continuity_check_count) / (float(continuity_check_end - ctx->continuity_check_start) / 1000);
+            ctx->continuity_check_count = 0;
+            ctx->continuity_check_start = getCurTime();
+        }
+
+        // 只有算法检测或推流需要时才转换bgr
+        if (ctx->pushBgr) {
+            bgrFrame = executor->mVideoFramePool->gain();
+            av_image_fill_arrays(frame_bgr->data, frame_bgr->linesize, bgrFrame->data, AV_PIX_FMT_BGR24, width, height, 1);
+
+            // frame（yuv420p） 转 frame_bgr
+            sws_scale(ctx->sws_ctx_yuv420p2bgr,
+                frame_yuv420p->data, frame_yuv420p->linesize, 0, height,
+                frame_bgr->data, frame_bgr->linesize);
+        }
+        if (cur_is_check) {
+            checkFrame = executor->mCheckFramePool->gain();
+            av_image_fill_arrays(frame_check_bgr->data, frame_check_bgr->linesize, checkFrame->data,
+                AV_PIX_FMT_BGR24, ctx->checkWidth, ctx->checkHeight, 1);
+            sws_scale(ctx->sws_ctx_check,
+                frame_yuv420p->data, frame_yuv420p->linesize, 0, height,
+                frame_check_bgr->data, frame_check_bgr->linesize);
+        }
+
+        float happenScore = 0;
+        bool happen = executor->mAnalyzer->checkVideoFrame(cur_is_check, ctx->frameCount, checkFrame, happenScore);
+        executor->mAnalyzer->drawVideoFrameYuv420p(videoFrame->data);
+        videoFrame->happen = happen;
+        videoFrame->happenScore = happenScore;
+        ctx->happen = happen;
+        if (happen && executor->mReducedDecode && !executor->mGenerateAlarm->isRemux()) {
+            // 报警视频需要连续的帧，报警期间恢复完整解码（从下一个关键帧开始）
+            // remux时报警视频直接使用原始pkt，不需要完整解码
+            executor->mFullDecodeUntil = getCurTime() + executor->mScheduler->getConfig()->reducedDecodeFullMs;
+        }
+
+        if (executor->mControl->pushStream) {
+            if (ctx->pushBgr) {
+                executor->mAnalyzer->drawVideoFrame(bgrFrame->data);
+                bgrFrame->happen = happen;
+                bgrFrame->happenScore = happenScore;
+                executor->mPushStream->pushVideoFrame(bgrFrame);
             }
             else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                executor->mPushStream->pushVideoFrame(videoFrame);
             }
         }
+        if (!executor->mGenerateAlarm->isRemux()) {
+            executor->mGenerateAlarm->pushVideoFrame(videoFrame);
+        }
+        videoFrame.reset();
+        bgrFrame.reset();
+        checkFrame.reset();
+    }
 
+    bool ControlExecutor::decodeAndAnalyzeVideo(void* arg) {
 
-        av_frame_free(&frame_yuv420p);
-        //av_frame_unref(frame_yuv420p);
-        frame_yuv420p = NULL;
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        VideoDecodeContext* ctx = executor->mDecodeCtx;
 
-        av_frame_free(&frame_bgr);
-        //av_frame_unref(frame_bgr);
-        frame_bgr = NULL;
+        AVPacket pkt; // 未解码的视频帧
+        int      pktQSize = 0; // 未解码视频帧队列当前长度
+        if (!executor->mPullStream->getVideoPkt(pkt, pktQSize)) {
+            return false;
+        }
 
+        AVCodecContext* codecCtx = executor->mPullStream->mVideoCodecCtx;
+        int ret = -1;
 
-        av_free(frame_bgr_buff);
-        frame_bgr_buff = NULL;
+        if (executor->mControl->videoIndex > -1 && AvPullStream::isVideoEndPkt(pkt)) {
+            // 文件读取结束，取出解码器中缓存的帧，之后重置解码器以便重新读取
+            ret = avcodec_send_packet(codecCtx, NULL);
+            if (ret == 0) {
+                receiveVideoFrames(executor);
+            }
+            avcodec_flush_buffers(codecCtx);
+        }
+        else if (executor->mControl->videoIndex > -1 && executor->needDecodeVideoPkt(pkt)) {
 
+            ret = avcodec_send_packet(codecCtx, &pkt);
+            if (ret == AVERROR(EAGAIN)) {
+                // 解码器中还有未取出的帧，取出后重新送入，否则该pkt丢失
+                receiveVideoFrames(executor);
+                ret = avcodec_send_packet(codecCtx, &pkt);
+            }
+            if (ret == 0) {
+                // 一个pkt可能解出多帧，全部取出
+                receiveVideoFrames(executor);
+            }
+            else {
+                LOGE("avcodec_send_packet error : ret=%d", ret);
+            }
+        }
 
-        sws_freeContext(sws_ctx_yuv420p2bgr);
-        sws_ctx_yuv420p2bgr = NULL;
+        // remux时报警视频直接使用原始pkt（包括未解码的pkt），不需要逐帧压缩图片
+        if (executor->mGenerateAlarm->isRemux() && !AvPullStream::isVideoEndPkt(pkt)) {
+            AVSAlarm* alarm = executor->mGenerateAlarm->pushVideoPkt(pkt, executor->mPullStream->mVideoStream, ctx->happen);
+            if (alarm) {
+                executor->mScheduler->addAlarm(alarm);
+            }
+        }
 
+        // 队列获取的pkt，必须释放!!!
+        //av_free_packet(&pkt);//过时
+        av_packet_unref(&pkt);
+        return true;
     }
-}
\ No newline at end of file
+}
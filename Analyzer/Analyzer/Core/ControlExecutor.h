@@ -3,46 +3,19 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include "VideoFrame.h"
+struct AVPacket;
 namespace AVSAnalyzer {
 	class Scheduler;
 	class AvPullStream;
 	class AvPushStream;
 	class GenerateAlarm;
 	class Analyzer;
+	class VideoFramePool;
 	struct Control;
-
-	struct VideoFrame
-	{
-	public:
-		enum VideoFrameType
-		{
-			BGR = 0,
-			YUV420P,
-
-		};
-		VideoFrame(VideoFrameType type, int size, int width, int height) {
-			this->type = type;
-			this->size = size;
-			this->width = width;
-			this->height = height;
-			this->data = new uint8_t[this->size];
-
-		}
-		~VideoFrame() {
-			delete[] this->data;
-			this->data = nullptr;
-		}
-
-		VideoFrameType type;
-		int size;
-		int width;
-		int height;
-		uint8_t* data;
-		bool happen = false;// 是否发生事件
-		float happenScore = 0;// 发生事件的分数
-
-
-	};
+	class StageExecutor;
+	class Stage;
+	struct VideoDecodeContext;
 
 	class ControlExecutor
 	{
@@ -56,12 +29,21 @@ namespace AVSAnalyzer {
 
 		~ControlExecutor();
 	public:
-		static void decodeAndAnalyzeVideoThread(void* arg);// 解码视频帧和实时分析视频帧
+		static bool decodeAndAnalyzeVideo(void* arg);// 取一个pkt解码并实时分析，队列为空时返回false
+		static bool hasVideoPkt(void* arg);
 	public:
 		bool start(std::string& msg);
 
 		bool getState();
 		void setState_remove();
+		void updateStats();// 更新布控的帧池和队列统计信息
+	private:
+		void initCheckSize();// 根据算法输入尺寸计算送入算法的图像宽高
+		void initDecode();   // 创建解码分析阶段使用的帧和格式转换上下文
+		void releaseDecode();
+		bool needDecodeVideoPkt(const AVPacket& pkt);// 降低解码量时判断当前pkt是否需要送入解码器
+		static void receiveVideoFrames(ControlExecutor* executor);// 取出解码器中所有已解码的帧并分析
+		static void analyzeVideoFrame(ControlExecutor* executor); // 分析刚解码的一帧，送入推流和报警
 	public:
 		Control* mControl;
 		Scheduler* mScheduler;
@@ -69,10 +51,25 @@ namespace AVSAnalyzer {
 		AvPushStream* mPushStream;
 		GenerateAlarm* mGenerateAlarm;
 		Analyzer* mAnalyzer;
+		VideoFramePool* mVideoFramePool;// bgr帧池，推流不使用yuv时使用
+		VideoFramePool* mYuvFramePool;  // yuv420p帧池，每个解码帧都使用
+		VideoFramePool* mCheckFramePool;// 送入算法的bgr帧池，按算法输入尺寸缩小
+		StageExecutor* mStageExecutor;
+		Stage* mDecodeStage;
+		Stage* mAlarmStage;
+		Stage* mPushStage;// 不推流时为nullptr
 
 	private:
 		bool mState = false;
-		std::vector<std::thread*> mThreads;
+		std::vector<std::thread*> mThreads;// 拉流的读取线程和推流的写入线程
+		VideoDecodeContext* mDecodeCtx;
+
+		// 降低解码量，只在解码线程中使用 start
+		bool    mReducedDecode = false;
+		int64_t mGopIndex = 0;
+		bool    mGopDecoding = false;   // 当前GOP是否完整解码
+		int64_t mFullDecodeUntil = 0;   // 发生报警后在该时间（毫秒）之前完整解码
+		// 降低解码量，只在解码线程中使用 end
 
 	};
 }
@@ -6,6 +6,7 @@
 #include "ControlExecutor.h"
 #include "Scheduler.h"
 #include <vector>
+#include <algorithm>
 
 #ifndef WIN32
 #include <opencv2/opencv.hpp>
@@ -17,23 +18,28 @@
 #endif
 #endif //WIN32
 
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
 namespace AVSAnalyzer {
 
-    bool gen_turboJpeg_compress(int height, int width, int channels, unsigned char* bgr, unsigned char*& out_data, unsigned long* out_size) {
-#ifdef WIN32
-#ifndef _DEBUG
+    // 事件发生前的pkt缓存最多比需要的时长多缓存的秒数，覆盖常见的长GOP
+    static const int PKT_CACHE_EXTRA_SECONDS = 30;
+
+    bool gen_turboJpeg_compress(int height, int width, unsigned char* yuv420p, unsigned char*& out_data, unsigned long* out_size) {
+#if defined(WIN32) && !defined(_DEBUG)
 
         tjhandle handle = tjInitCompress();
         if (nullptr == handle) {
             return false;
         }
 
-        //pixel_format : TJPF::TJPF_BGR or other
+        // 直接压缩yuv420p平面（pad=1，与帧池中的内存布局一致），不需要先转换为bgr
         const int JPEG_QUALITY = 75;
-        int pixel_format = TJPF::TJPF_BGR;
-        int pitch = tjPixelSize[pixel_format] * width;
-        int ret = tjCompress2(handle, bgr, width, pitch, height, pixel_format,
-            &out_data, out_size, TJSAMP_444, JPEG_QUALITY, TJFLAG_FASTDCT);
+        int ret = tjCompressFromYUV(handle, yuv420p, width, 1, height, TJSAMP_420,
+            &out_data, out_size, JPEG_QUALITY, TJFLAG_FASTDCT);
 
         tjDestroy(handle);
 
@@ -42,51 +48,78 @@ namespace AVSAnalyzer {
         }
         return true;
 
-#endif // !_DEBUG
-#endif //WIN32
+#endif
 
         return false;
     }
 
-    bool genCompressImage(int height, int width, int channels, unsigned char* bgr, AVSAlarmImage* image) {
-#ifdef WIN32
-#ifndef _DEBUG
+    // 先压缩，再按压缩后的大小从图片池获取图片，失败或超出图片池的内存预算时返回nullptr
+    AVSAlarmImage* genCompressImage(Scheduler* scheduler, int height, int width, int channels, unsigned char* yuv420p) {
+        AVSAlarmImage* image = nullptr;
+#if defined(WIN32) && !defined(_DEBUG)
         unsigned char* jpeg_data = nullptr;
         unsigned long  jpeg_size = 0;
 
-        gen_turboJpeg_compress(height, width, channels, bgr, jpeg_data, &jpeg_size);
+        gen_turboJpeg_compress(height, width, yuv420p, jpeg_data, &jpeg_size);
 
         if (jpeg_size > 0 && jpeg_data != nullptr) {
-            image->set(jpeg_data, jpeg_size, width, height, channels);
+            image = scheduler->gainAlarmImage(jpeg_size);
+            if (image) {
+                image->set(jpeg_data, jpeg_size, width, height, channels);
+            }
             free(jpeg_data);
             jpeg_data = nullptr;
-            return true;
-        }
-        else {
-            return false;
         }
 
 #else
-        cv::Mat bgr_image(height, width, CV_8UC3, bgr);
+        // OpenCV的I420要求宽高为偶数；帧池中色度平面为(w+1)/2 x (h+1)/2，
+        // 宽高为奇数时把亮度平面补齐到偶数（重复最后一列/行），色度平面不变，转换后再裁回原尺寸
+        int evenWidth = (width + 1) & ~1;
+        int evenHeight = (height + 1) & ~1;
+        unsigned char* src = yuv420p;
+        std::vector<uchar> padded;
+        if (evenWidth != width || evenHeight != height) {
+            int chromaSize = 2 * (evenWidth / 2) * (evenHeight / 2);
+            padded.resize(evenWidth * evenHeight + chromaSize);
+            for (int y = 0; y < evenHeight; y++)
+            {
+                const unsigned char* srcRow = yuv420p + std::min(y, height - 1) * width;
+                unsigned char* dstRow = padded.data() + y * evenWidth;
+                memcpy(dstRow, srcRow, width);
+                if (evenWidth != width) {
+                    dstRow[width] = srcRow[width - 1];
+                }
+            }
+            memcpy(padded.data() + evenWidth * evenHeight, yuv420p + width * height, chromaSize);
+            src = padded.data();
+        }
+        cv::Mat yuv_image(evenHeight * 3 / 2, evenWidth, CV_8UC1, src);
+        cv::Mat bgr_image;
+        cv::cvtColor(yuv_image, bgr_image, cv::COLOR_YUV2BGR_I420);
+        if (evenWidth != width || evenHeight != height) {
+            bgr_image = bgr_image(cv::Rect(0, 0, width, height)).clone();
+        }
         std::vector<int> quality = { 100 };
         std::vector<uchar> jpeg_data;
         cv::imencode(".jpg", bgr_image, jpeg_data, quality);
-        image->set(jpeg_data.data(), jpeg_data.size(), width, height, channels);
-        return true;
-
-
-#endif // !_DEBUG
+        if (!jpeg_data.empty()) {
+            image = scheduler->gainAlarmImage(jpeg_data.size());
+            if (image) {
+                image->set(jpeg_data.data(), jpeg_data.size(), width, height, channels);
+            }
+        }
 
-#endif //WIN32
+#endif
+        return image;
     }
 
 
-    AVSAlarmImage* AVSAlarmImage::Create(int width, int height, int channels) {
-        return new AVSAlarmImage(width,height,channels);
+    AVSAlarmImage* AVSAlarmImage::Create(int capacity) {
+        return new AVSAlarmImage(capacity);
     }
-    AVSAlarmImage::AVSAlarmImage(int width, int height, int channels) {
-        this->size = width * height * channels;
-        this->data = (unsigned char*)malloc(this->size);
+    AVSAlarmImage::AVSAlarmImage(int capacity) {
+        this->capacity = capacity;
+        this->data = (unsigned char*)malloc(this->capacity);
     }
     AVSAlarmImage::~AVSAlarmImage() {
         if (this->data) {
@@ -94,18 +127,23 @@ namespace AVSAnalyzer {
             this->data = nullptr;
         }
         this->size = 0;
+        this->capacity = 0;
         this->width = 0;
         this->height = 0;
         this->channels = 0;
 
     }
 
-    void AVSAlarmImage::set(unsigned char* data, int size, int width, int height, int channels) {
+    bool AVSAlarmImage::set(unsigned char* data, int size, int width, int height, int channels) {
+        if (size > this->capacity) {
+            return false;
+        }
         memcpy(this->data, data, size);
         this->size = size;
         this->width = width;
         this->height = height;
         this->channels = channels;
+        return true;
     }
 
     unsigned char* AVSAlarmImage::getData() {
@@ -123,6 +161,9 @@ namespace AVSAnalyzer {
     int AVSAlarmImage::getChannels() {
         return this->channels;
     }
+    int AVSAlarmImage::getCapacity() {
+        return this->capacity;
+    }
     AVSAlarm* AVSAlarm::Create(int height, int width, int fps, int64_t happen, const char* controlCode) {
 
         AVSAlarm* alarm = new AVSAlarm;
@@ -140,181 +181,286 @@ namespace AVSAnalyzer {
     }
     AVSAlarm::~AVSAlarm() {
         LOGI("");
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            av_packet_free(&packets[i]);
+        }
+        packets.clear();
+        if (codecpar) {
+            avcodec_parameters_free(&codecpar);
+        }
     }
 
 
-    GenerateAlarm::GenerateAlarm(Config* config, Control* control) :
-        mConfig(config),
-        mControl(control)
+    GenerateAlarm::GenerateAlarm(Scheduler* scheduler, Control* control) :
+        mScheduler(scheduler),
+        mConfig(scheduler->getConfig()),
+        mControl(control),
+        mDroppedHappen(false),
+        mVideoFrameQ(std::max(mConfig->alarmFrameQueueCapacity, control->videoFps > 0 ? control->videoFps : 25),
+            parseQueueDropPolicy(mConfig->alarmFrameQueuePolicy, QUEUE_DROP_OLDEST),
+            [this](VideoFramePtr& frame) {
+                // 丢弃的帧发生了事件时，转移到下一个被处理的帧，避免丢失报警
+                if (frame && frame->happen) {
+                    mDroppedHappen = true;
+                }
+            })
     {
-
+        std::string mode = control->alarmVideoMode.empty() ? mConfig->alarmVideoMode : control->alarmVideoMode;
+        mRemux = "overlay" != mode;
+
+        // 缓存容量由帧率和配置的时长决定，每路布控占用的内存是确定的
+        int fps = control->videoFps > 0 ? control->videoFps : 25;
+        mCacheMinSize = fps * std::max(mConfig->alarmPreSeconds, 0);
+        if (!mRemux) {
+            int cacheCapacity = mCacheMinSize + fps;
+            mCacheV.reset(cacheCapacity);
+            mHappenV.reset(std::max(fps * mConfig->alarmVideoSeconds, cacheCapacity + 1));
+        }
     }
 
     GenerateAlarm::~GenerateAlarm()
     {
         clearVideoFrameQueue();
+        clearVideoPktCache();
+        clearAlarmImageCache();
     }
 
 
-    void GenerateAlarm::pushVideoFrame(unsigned char* data, int size, bool happen, float happenScore) {
-
-        VideoFrame* frame = new VideoFrame(VideoFrame::BGR, size, mControl->videoWidth, mControl->videoHeight);
-        frame->size = size;
-        memcpy(frame->data, data, size);
-        frame->happen = happen;
-        frame->happenScore = happenScore;
+    void GenerateAlarm::pushVideoFrame(VideoFramePtr frame) {
 
-        mVideoFrameQ_mtx.lock();
         mVideoFrameQ.push(frame);
-        mVideoFrameQ_mtx.unlock();
 
     }
-    bool GenerateAlarm::getVideoFrame(VideoFrame*& frame, int& frameQSize) {
+    void GenerateAlarm::getVideoFrameQueueStats(int& size, int64_t& dropCount) {
+        size = mVideoFrameQ.size();
+        dropCount = mVideoFrameQ.getDropCount();
+    }
+    void GenerateAlarm::clearVideoFrameQueue() {
 
-        mVideoFrameQ_mtx.lock();
+        mVideoFrameQ.clear();
 
-        if (!mVideoFrameQ.empty()) {
-            frame = mVideoFrameQ.front();
-            mVideoFrameQ.pop();
-            frameQSize = mVideoFrameQ.size();
-            mVideoFrameQ_mtx.unlock();
-            return true;
+    }
 
+    void GenerateAlarm::clearVideoPktCache() {
+        for (size_t i = 0; i < mPktCacheV.size(); i++)
+        {
+            av_packet_free(&mPktCacheV[i]);
         }
-        else {
-            mVideoFrameQ_mtx.unlock();
-            return false;
+        mPktCacheV.clear();
+        mPktKeySeqV.clear();
+        for (size_t i = 0; i < mPktHappenV.size(); i++)
+        {
+            av_packet_free(&mPktHappenV[i]);
         }
-
+        mPktHappenV.clear();
     }
-    void GenerateAlarm::clearVideoFrameQueue() {
-
-        mVideoFrameQ_mtx.lock();
-        while (!mVideoFrameQ.empty())
+    void GenerateAlarm::clearAlarmImageCache() {
+        AVSAlarmImage* image = nullptr;
+        while (mCacheV.pop(image)) {
+            mScheduler->giveBackAlarmImage(image);
+        }
+        while (mHappenV.pop(image)) {
+            mScheduler->giveBackAlarmImage(image);
+        }
+    }
+    void GenerateAlarm::dropVideoPktGop() {
+        int64_t dropCount = mPktKeySeqV[1] - mPktKeySeqV[0];
+        for (int64_t i = 0; i < dropCount; i++)
         {
-            VideoFrame* frame = mVideoFrameQ.front();
-            mVideoFrameQ.pop();
-            delete frame;
-            frame = nullptr;
+            av_packet_free(&mPktCacheV.front());
+            mPktCacheV.pop_front();
+        }
+        mPktKeySeqV.pop_front();
+    }
+    bool GenerateAlarm::isRemux() {
+        return mRemux;
+    }
+    AVSAlarm* GenerateAlarm::pushVideoPkt(const AVPacket& pkt, AVStream* stream, bool happen) {
+        int fps = mControl->videoFps > 0 ? mControl->videoFps : 25;
+        size_t preSize = (size_t)mCacheMinSize;                     // 事件发生前最少缓存的pkt数
+        size_t alarmSize = (size_t)fps * mConfig->alarmVideoSeconds;// 报警视频的pkt数
+        bool key = (pkt.flags & AV_PKT_FLAG_KEY) != 0;
+
+        if (mHappening) {// 报警事件已经发生，正在进行中
+            AVPacket* clone = av_packet_clone(&pkt);// 只增加引用计数，不复制数据
+            if (clone) {
+                mPktHappenV.push_back(clone);
+            }
+            if (mPktHappenV.size() < mPktHappenEndSize) {
+                return nullptr;
+            }
+            mLastAlarmTimestamp = getCurTimestamp();
+
+            AVSAlarm* alarm = AVSAlarm::Create(
+                mControl->videoHeight,
+                mControl->videoWidth,
+                fps,
+                mLastAlarmTimestamp,
+                mControl->code.data()
+            );
+            alarm->packets.swap(mPktHappenV);
+            alarm->codecpar = avcodec_parameters_alloc();
+            avcodec_parameters_copy(alarm->codecpar, stream->codecpar);
+            alarm->timeBaseNum = stream->time_base.num;
+            alarm->timeBaseDen = stream->time_base.den;
+
+            mHappening = false;
+            return alarm;
+        }
+
+        // 暂未发生报警事件，缓存必须从关键帧开始，之前的pkt无法单独解码
+        if (!key && mPktCacheV.empty()) {
+            return nullptr;
+        }
+        AVPacket* clone = av_packet_clone(&pkt);
+        if (!clone) {
+            return nullptr;
         }
-        mVideoFrameQ_mtx.unlock();
+        if (key) {
+            mPktKeySeqV.push_back(mPktSeq);
+        }
+        mPktCacheV.push_back(clone);
+        mPktSeq++;
 
+        // 按GOP整体淘汰：从第二个关键帧开始已经满足事件发生前的时长时，第一个GOP不再需要
+        while (mPktKeySeqV.size() > 1 && mPktSeq - mPktKeySeqV[1] >= (int64_t)preSize) {
+            dropVideoPktGop();
+        }
+        // 帧内刷新或GOP很长的流迟迟没有下一个关键帧，缓存超过上限时强制淘汰，
+        // 只剩一个GOP时全部丢弃，等待下一个关键帧重新缓存
+        size_t maxSize = preSize + (size_t)fps * PKT_CACHE_EXTRA_SECONDS;
+        while (mPktCacheV.size() > maxSize) {
+            if (mPktKeySeqV.size() > 1) {
+                dropVideoPktGop();
+            }
+            else {
+                LOGE("pkt cache exceeds %d packets without a new keyframe, code=%s", (int)maxSize, mControl->code.data());
+                for (size_t i = 0; i < mPktCacheV.size(); i++)
+                {
+                    av_packet_free(&mPktCacheV[i]);
+                }
+                mPktCacheV.clear();
+                mPktKeySeqV.clear();
+                return nullptr;
+            }
+        }
+
+        if (happen && mPktCacheV.size() >= preSize &&
+            (getCurTimestamp() - mLastAlarmTimestamp) > mControl->alarmMinInterval) {
+            //满足报警触发帧
+            mHappening = true;
+            mPktHappenV.assign(mPktCacheV.begin(), mPktCacheV.end());
+            mPktCacheV.clear();
+            mPktKeySeqV.clear();
+            // GOP较长时缓存会超过事件发生前的时长，事件发生后至少保留1秒
+            mPktHappenEndSize = mPktHappenV.size() + std::max(alarmSize > preSize ? alarmSize - preSize : 0, (size_t)fps);
+        }
+        return nullptr;
     }
 
-    void GenerateAlarm::generateAlarmThread(void* arg) {
+    void GenerateAlarm::setVideoFrameNotify(std::function<void()> notify) {
+        mVideoFrameQ.setNotify(notify);
+    }
+    bool GenerateAlarm::hasVideoFrame(void* arg) {
         ControlExecutor* executor = (ControlExecutor*)arg;
+        return executor->mGenerateAlarm->mVideoFrameQ.size() > 0;
+    }
+
+    bool GenerateAlarm::generateAlarm(void* arg) {
+        ControlExecutor* executor = (ControlExecutor*)arg;
+        GenerateAlarm* generateAlarm = executor->mGenerateAlarm;
         int width = executor->mControl->videoWidth;
         int height = executor->mControl->videoHeight;
         int channels = 3;
 
-        VideoFrame* videoFrame = nullptr; // 未编码的视频帧（bgr格式）
+        VideoFramePtr videoFrame; // 未编码的视频帧（yuv420p格式）
         int         videoFrameQSize = 0; // 未编码视频帧队列当前长度
+        if (!generateAlarm->mVideoFrameQ.tryPop(videoFrame, videoFrameQSize)) {
+            return false;
+        }
+        // 帧可能同时在推流中使用，不修改帧本身的happen
+        bool happen = videoFrame->happen;
+        if (generateAlarm->mDroppedHappen.exchange(false)) {
+            happen = true;
+        }
 
-        std::vector<AVSAlarmImage* > cacheV;
-        int cacheV_max_size = 75; //75 = 25 * 3，最多缓存事件发生前3秒的数据，1张压缩图片100kb
-        int cacheV_min_size = 50;  // 50 = 25 * 2, 最少缓存事件发生前2秒的数据
-
-        bool happening = false;// 当前是否正在发生报警行为
-        std::vector<AVSAlarmImage* > happenV;
-        int     happenV_alarm_max_size = 150;//报警总帧数最大长度
-        int64_t last_alarm_timestamp = 0;// 上一次报警的时间戳
+        RingBuffer<AVSAlarmImage* >& cacheV = generateAlarm->mCacheV;
+        RingBuffer<AVSAlarmImage* >& happenV = generateAlarm->mHappenV;
 
         int64_t t1, t2 = 0;
 
-        while (executor->getState())
-        {
-            if (executor->mGenerateAlarm->getVideoFrame(videoFrame, videoFrameQSize)) {
-
-                t1 = getCurTime();
-
-                AVSAlarmImage* image = executor->mScheduler->gainAlarmImage();
-
-                bool comp = genCompressImage(height, width, channels, videoFrame->data, image);
-
-                if (comp) {
-                    image->happen = videoFrame->happen;
-                    image->happenScore = videoFrame->happenScore;
-                }
+        t1 = getCurTime();
 
-                t2 = getCurTime();
+        AVSAlarmImage* image = genCompressImage(executor->mScheduler, height, width, channels, videoFrame->data);
 
-                if (happening) {// 报警事件已经发生，正在进行中
+        bool comp = image != nullptr;
 
-                    if (comp) {
-                        happenV.push_back(image);
-                        //LOGI("h=%d,w=%d,compressSize=%lu,compress spend: %lld(ms),happenV.size=%lld",
-                        //    height, width, compressImage->size, (t2 - t1), happenV.size());
-                    }
-                    else {
-                        executor->mScheduler->giveBackAlarmImage(image);
-                    }
-
-                    if (happenV.size() >= happenV_alarm_max_size) {
-                        last_alarm_timestamp = getCurTimestamp();
-
-                        AVSAlarm* alarm = AVSAlarm::Create(
-                            height,
-                            width,
-                            executor->mControl->videoFps,
-                            last_alarm_timestamp,
-                            executor->mControl->code.data()
-                        );
+        if (comp) {
+            image->happen = happen;
+            image->happenScore = videoFrame->happenScore;
+        }
 
-                        for (size_t i = 0; i < happenV.size(); i++)
-                        {
-                            alarm->images.push_back(happenV[i]);
-                        }
-                        happenV.clear();
+        t2 = getCurTime();
 
-                        executor->mScheduler->addAlarm(alarm);
+        if (generateAlarm->mHappening) {// 报警事件已经发生，正在进行中
 
-                        happening = false;
-                    }
-                    delete videoFrame;
-                    videoFrame = nullptr;
+            if (comp && !happenV.push(image)) {
+                executor->mScheduler->giveBackAlarmImage(image);
+            }
 
+            // 图片池超出内存预算时提前结束报警，尽快归还已占用的图片
+            if (happenV.full() || !comp) {
+                generateAlarm->mLastAlarmTimestamp = getCurTimestamp();
+
+                AVSAlarm* alarm = AVSAlarm::Create(
+                    height,
+                    width,
+                    executor->mControl->videoFps,
+                    generateAlarm->mLastAlarmTimestamp,
+                    executor->mControl->code.data()
+                );
+
+                // 只转移图片的指针，不复制图片数据
+                alarm->images.reserve(happenV.size());
+                while (happenV.pop(image)) {
+                    alarm->images.push_back(image);
                 }
-                else {// 暂未发生报警事件
-
-                    if (comp) {
 
-                        cacheV.push_back(image);
+                executor->mScheduler->addAlarm(alarm);
 
-                        //LOGI("cache h=%d,w=%d,compressSize=%d,compress spend: %lld(ms),cacheQ.size=%lld",height, width, compressImage.getSize(), (t2 - t1), cacheV.size());
+                generateAlarm->mHappening = false;
+            }
+            videoFrame.reset();
 
+        }
+        else {// 暂未发生报警事件
 
-                        if (!cacheV.empty() && cacheV.size() > cacheV_max_size) {
-                            //满足缓存过期帧
-                            auto b = cacheV.begin();
-                            cacheV.erase(b);
-                            AVSAlarmImage* headImage = *b;
-                            executor->mScheduler->giveBackAlarmImage(headImage);
-                        }
+            if (comp) {
 
+                if (cacheV.full()) {
+                    //满足缓存过期帧
+                    AVSAlarmImage* headImage = nullptr;
+                    cacheV.pop(headImage);
+                    executor->mScheduler->giveBackAlarmImage(headImage);
+                }
+                cacheV.push(image);
 
-                        if (videoFrame->happen && cacheV.size() > cacheV_min_size &&
-                            (getCurTimestamp() - last_alarm_timestamp) > executor->mControl->alarmMinInterval) {
-                            //满足报警触发帧
-                            happening = true;
-                            happenV = cacheV;
-                            cacheV.clear();
-                        }
+                //LOGI("cache h=%d,w=%d,compressSize=%d,compress spend: %lld(ms),cacheQ.size=%d",height, width, image->getSize(), (t2 - t1), cacheV.size());
 
+                if (happen && cacheV.size() > generateAlarm->mCacheMinSize &&
+                    (getCurTimestamp() - generateAlarm->mLastAlarmTimestamp) > executor->mControl->alarmMinInterval) {
+                    //满足报警触发帧
+                    generateAlarm->mHappening = true;
+                    while (cacheV.pop(image)) {
+                        happenV.push(image);
                     }
-                    else {
-                        executor->mScheduler->giveBackAlarmImage(image);
-                    }
-                    delete videoFrame;
-                    videoFrame = nullptr;
                 }
 
             }
-            else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(2));
-            }
-
+            videoFrame.reset();
         }
 
-
+        return true;
     }
 }
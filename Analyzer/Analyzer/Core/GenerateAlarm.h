@@ -1,23 +1,32 @@
 ﻿#ifndef ANALYZER_GENERATEALARM_H
 #define ANALYZER_GENERATEALARM_H
 
-#include <queue>
-#include <mutex>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include "VideoFrame.h"
+#include "Utils/BlockingQueue.h"
+#include "Utils/RingBuffer.h"
+struct AVPacket;
+struct AVStream;
+struct AVCodecParameters;
 namespace AVSAnalyzer {
 
 	class Config;
 	struct Control;
-	struct VideoFrame;
+	class Scheduler;
+	struct AlarmSpillSegment;
 
 	struct AVSAlarmImage
 	{
 	public:
-		static AVSAlarmImage* Create(int width, int height, int channels);
+		static AVSAlarmImage* Create(int capacity);// 由AlarmImagePool按压缩后的大小分级创建
 		~AVSAlarmImage();
 	private:
-		AVSAlarmImage(int width, int height, int channels);
+		explicit AVSAlarmImage(int capacity);
 	public:
-		void set(unsigned char* data, int size, int width, int height, int channels);
+		bool set(unsigned char* data, int size, int width, int height, int channels);// size超过容量时返回false
 
 		bool  happen = false;// 是否发生事件
 		float happenScore = 0;// 发生事件的分数
@@ -27,14 +36,25 @@ namespace AVSAnalyzer {
 		int getWidth();
 		int getHeight();
 		int getChannels();
+		int getCapacity();
 	private:
 
 		unsigned char* data = nullptr;//图片经过jpg压缩后的数据
+		int capacity = 0;             //data分配的内存长度
 		int size = 0;                 //图片经过jpg压缩后的数据长度
 		int width = 0;                //原图宽
 		int height = 0;               //原图高
 		int channels = 0;             //原图通道长
 	};
+	// 落盘的报警图片，data指向落盘分段的映射内存
+	struct AVSAlarmSpillImage
+	{
+		const unsigned char* data = nullptr;
+		int size = 0;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+	};
 	struct AVSAlarm
 	{
 	public:
@@ -48,28 +68,66 @@ namespace AVSAnalyzer {
 		int fps = 0;
 		int64_t happen = 0;
 		std::string controlCode;// 布控编号
+		int64_t addTime = 0;    // 加入报警队列的时间（getCurTime，毫秒）
 
 		AVSAlarmImage* headImage = nullptr;//封面图
 		std::vector<AVSAlarmImage*> images;//组成报警视频的图片帧
+
+		// remux模式 start
+		std::vector<AVPacket*> packets;// 组成报警视频的原始pkt（解码顺序，从关键帧开始），析构时释放
+		AVCodecParameters* codecpar = nullptr;// 原始视频流的编码参数，析构时释放
+		int timeBaseNum = 0;// 原始视频流的时间基
+		int timeBaseDen = 0;
+		// remux模式 end
+
+		// 落盘 start
+		AlarmSpillSegment* spillSegment = nullptr;// 图片所在的落盘分段，为nullptr时图片在images中
+		int64_t spillOffset = 0;                  // 报警记录在分段中的偏移
+		std::vector<AVSAlarmSpillImage> spillImages;
+		// 落盘 end
 	};
 
 	class GenerateAlarm
 	{
 	public:
-		GenerateAlarm(Config* config, Control* control);
+		GenerateAlarm(Scheduler* scheduler, Control* control);
 		~GenerateAlarm();
 	public:
-		void pushVideoFrame(unsigned char* data, int size, bool happen, float happenScore);
+		void pushVideoFrame(VideoFramePtr frame);
+		void setVideoFrameNotify(std::function<void()> notify);// 有新的视频帧时通知
+		void getVideoFrameQueueStats(int& size, int64_t& dropCount);
+		bool isRemux();// 报警视频是否由原始pkt直接封装，此时不需要推入视频帧
+		// 由解码阶段调用，缓存一个原始pkt（不论是否解码），happen为最近一次的检测结果
+		// 报警视频的pkt收集完成时返回报警，否则返回nullptr
+		AVSAlarm* pushVideoPkt(const AVPacket& pkt, AVStream* stream, bool happen);
 	public:
-		static void generateAlarmThread(void* arg);
+		static bool generateAlarm(void* arg); // 取一个视频帧压缩并生成报警，队列为空时返回false
+		static bool hasVideoFrame(void* arg);
 	private:
+		Scheduler* mScheduler;
 		Config* mConfig;
 		Control* mControl;
+		bool mRemux;
+		int  mCacheMinSize;// 事件发生前最少缓存的图片数
+
+		// 报警状态，remux时只在解码阶段使用，否则只在报警阶段使用 start
+		RingBuffer<AVSAlarmImage* > mCacheV; // 事件发生前缓存的图片，容量为事件发生前的时长加1秒
+		RingBuffer<AVSAlarmImage* > mHappenV;// 组成报警视频的图片，容量为报警视频的总帧数
+		std::deque<AVPacket*> mPktCacheV;    // 事件发生前缓存的pkt，第一个始终是关键帧
+		std::deque<int64_t>   mPktKeySeqV;   // mPktCacheV中关键帧的序号
+		int64_t mPktSeq = 0;                 // 下一个缓存pkt的序号
+		std::vector<AVPacket*> mPktHappenV;  // 组成报警视频的pkt
+		size_t  mPktHappenEndSize = 0;       // mPktHappenV达到该长度时生成报警
+		bool    mHappening = false;       // 当前是否正在发生报警行为
+		int64_t mLastAlarmTimestamp = 0;  // 上一次报警的时间戳
+		// 报警状态 end
+		void clearVideoPktCache();
+		void dropVideoPktGop();// 丢弃mPktCacheV中的第一个GOP，调用前至少有两个关键帧
+		void clearAlarmImageCache();
 
-		//视频帧
-		std::queue <VideoFrame*> mVideoFrameQ;
-		std::mutex               mVideoFrameQ_mtx;
-		bool getVideoFrame(VideoFrame*& frame, int& frameQSize);
+		//视频帧，容量至少1秒
+		std::atomic<bool> mDroppedHappen;// 队列已满时丢弃了发生事件的帧，在队列之前声明，队列析构时仍然有效
+		BlockingQueue <VideoFramePtr> mVideoFrameQ;
 		void clearVideoFrameQueue();
 
 	};
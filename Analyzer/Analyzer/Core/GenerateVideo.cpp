@@ -3,6 +3,8 @@
 #include "Utils/Common.h"
 #include "Config.h"
 #include "GenerateAlarm.h"
+#include "Utils/ColorConvert.h"
+#include <atomic>
 
 #ifndef WIN32
 #include <opencv2/opencv.hpp>
@@ -25,15 +27,22 @@ extern "C" {
 
 namespace AVSAnalyzer {
 
-    bool genUnCompressImage(AVSAlarmImage* image, unsigned char*& out_bgr, int out_bgrSize) {
+    // 报警视频文件名：布控编号-报警时间-序号，多个报警线程同时生成同一布控的报警时不会重名
+    static std::atomic<int64_t> gVideoSeq(0);
+    static std::string genVideoUrl(Config* config, AVSAlarm* alarm, const char* ext) {
+        return config->rootVideoDir + "/" + alarm->controlCode + "-" + std::to_string(alarm->happen) +
+            "-" + std::to_string(gVideoSeq++) + ext;
+    }
 
-#ifdef WIN32
-#ifndef _DEBUG
-        unsigned char* jpeg_data = image->getData();
-        unsigned long jpeg_size = image->getSize();
-        int height = image->getHeight();
-        int width = image->getWidth();
-        int channels = image->getChannels();
+    // data为压缩图片的数据（来自AVSAlarmImage或落盘分段的映射内存）
+    bool genUnCompressImage(const unsigned char* data, int size, unsigned char*& out_bgr, int out_bgrSize) {
+
+#if defined(WIN32) && !defined(_DEBUG)
+        unsigned char* jpeg_data = (unsigned char*)data;
+        unsigned long jpeg_size = size;
+        int height = 0;
+        int width = 0;
+        int channels = 3;
 
         // 用于初始化 JPEG 解压缩处理的环境。它的主要作用是创建一个解压缩句柄 tjhandle，这个句柄将用于后续的解压缩操作
         tjhandle handle = tjInitDecompress();
@@ -86,78 +95,21 @@ namespace AVSAnalyzer {
 
 
 #else
-        std::vector<uchar> jpegBuffer(image->getSize());
-        memcpy(jpegBuffer.data(), image->getData(), image->getSize());
+        std::vector<uchar> jpegBuffer(data, data + size);
         cv::Mat bgr_image = cv::imdecode(jpegBuffer, CV_LOAD_IMAGE_UNCHANGED);
+        if (bgr_image.empty()) {
+            return false;
+        }
         memcpy(out_bgr, bgr_image.data, out_bgrSize);
 
         return true;
 
-#endif // !_DEBUG
-
-
-#endif //WIN32
-    }
-
-
-    // bgr24转yuv420p
-
-    static unsigned char clipValue(unsigned char x, unsigned char min_val, unsigned char  max_val) {
-
-        if (x > max_val) {
-            return max_val;
-        }
-        else if (x < min_val) {
-            return min_val;
-        }
-        else {
-            return x;
-        }
-    }
-
-    static bool bgr24ToYuv420p(unsigned char* bgrBuf, int w, int h, unsigned char* yuvBuf) {
-
-        unsigned char* ptrY, * ptrU, * ptrV, * ptrRGB;
-        memset(yuvBuf, 0, w * h * 3 / 2);
-        ptrY = yuvBuf;
-        ptrU = yuvBuf + w * h;
-        ptrV = ptrU + (w * h * 1 / 4);
-        unsigned char y, u, v, r, g, b;
-
-        // 每一行
-        for (int j = 0; j < h; ++j) {
-
-            ptrRGB = bgrBuf + w * j * 3;
-
-            // 每一列
-            for (int i = 0; i < w; i++) {
-
-                b = *(ptrRGB++);
-                g = *(ptrRGB++);
-                r = *(ptrRGB++);
-
-
-                y = (unsigned char)((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
-                u = (unsigned char)((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
-                v = (unsigned char)((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
-                *(ptrY++) = clipValue(y, 0, 255);
-                if (j % 2 == 0 && i % 2 == 0) {
-                    *(ptrU++) = clipValue(u, 0, 255);
-                }
-                else {
-                    if (i % 2 == 0) {
-                        *(ptrV++) = clipValue(v, 0, 255);
-                    }
-                }
-            }
-        }
-        return true;
+#endif
     }
 
 
-
-    GenerateVideo::GenerateVideo(Config* config, AVSAlarm* alarm) :
-        mConfig(config),mAlarm(alarm)
+    GenerateVideo::GenerateVideo(Config* config, AVSAlarm* alarm, int threadCount) :
+        mConfig(config),mAlarm(alarm),mThreadCount(threadCount > 0 ? threadCount : 1)
     {
         LOGI("");
     }
@@ -214,7 +166,7 @@ namespace AVSAnalyzer {
         mVideoCodecCtx->framerate = { mAlarm->fps, 1 };
         mVideoCodecCtx->gop_size = mAlarm->fps;
         mVideoCodecCtx->max_b_frames = 5;
-        mVideoCodecCtx->thread_count = 1;
+        mVideoCodecCtx->thread_count = mThreadCount;
 
         //mVideoCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;  //全局参数
             
@@ -319,10 +271,112 @@ namespace AVSAnalyzer {
 
     }
 
+    bool GenerateVideo::initRemuxCtx(const char* url) {
+
+        // flv只支持h264，其他编码格式封装为mp4
+        const char* format = AV_CODEC_ID_H264 == mAlarm->codecpar->codec_id ? "flv" : "mp4";
+        if (avformat_alloc_output_context2(&mFmtCtx, NULL, format, url) < 0) {
+            LOGE("avformat_alloc_output_context2 error");
+            return false;
+        }
+
+        mVideoStream = avformat_new_stream(mFmtCtx, NULL);
+        if (!mVideoStream) {
+            LOGE("avformat_new_stream error");
+            return false;
+        }
+        if (avcodec_parameters_copy(mVideoStream->codecpar, mAlarm->codecpar) < 0) {
+            LOGE("avcodec_parameters_copy error");
+            return false;
+        }
+        mVideoStream->codecpar->codec_tag = 0;// 原始封装的tag不一定适用于输出封装
+        mVideoStream->time_base = { mAlarm->timeBaseNum, mAlarm->timeBaseDen };
+        mVideoIndex = mVideoStream->index;
+
+        av_dump_format(mFmtCtx, 0, url, 1);
+
+        if (!(mFmtCtx->oformat->flags & AVFMT_NOFILE)) {
+            if (avio_open(&mFmtCtx->pb, url, AVIO_FLAG_WRITE) < 0) {
+                LOGE("avio_open error url=%s", url);
+                return false;
+            }
+        }
+
+        if (avformat_write_header(mFmtCtx, NULL) < 0) {
+            LOGE("avformat_write_header error");
+            return false;
+        }
+
+        return true;
+    }
+
+    bool GenerateVideo::remux() {
+
+        bool isH264 = AV_CODEC_ID_H264 == mAlarm->codecpar->codec_id;
+        std::string url = genVideoUrl(mConfig, mAlarm, isH264 ? ".flv" : ".mp4");
+
+        if (!initRemuxCtx(url.data())) {
+            return false;
+        }
+
+        AVRational src_time_base = { mAlarm->timeBaseNum, mAlarm->timeBaseDen };
+        int64_t frameDuration = 0;// 原始时间基下一帧的时长，pkt缺少时间戳时使用
+        if (mAlarm->fps > 0 && mAlarm->timeBaseNum > 0) {
+            frameDuration = av_rescale_q(1, { 1, mAlarm->fps }, src_time_base);
+        }
+
+        int64_t startDts = AV_NOPTS_VALUE;// 第一个pkt的时间戳，输出的时间戳从0开始
+        int64_t lastDts = AV_NOPTS_VALUE;
+        int64_t skipCount = 0;
+        int ret = -1;
+
+        for (size_t i = 0; i < mAlarm->packets.size(); i++)
+        {
+            AVPacket* pkt = mAlarm->packets[i];
+
+            if (AV_NOPTS_VALUE == pkt->dts) {
+                pkt->dts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : (int64_t)i * frameDuration;
+            }
+            if (AV_NOPTS_VALUE == pkt->pts) {
+                pkt->pts = pkt->dts;
+            }
+            if (AV_NOPTS_VALUE == startDts) {
+                startDts = pkt->dts;
+            }
+            pkt->dts -= startDts;
+            pkt->pts -= startDts;
+
+            // 拉流队列丢帧或时间戳跳变时dts可能不递增，封装器会报错，直接跳过
+            if (lastDts != AV_NOPTS_VALUE && pkt->dts <= lastDts) {
+                skipCount++;
+                continue;
+            }
+            lastDts = pkt->dts;
+
+            pkt->stream_index = mVideoIndex;
+            pkt->pos = -1;
+            av_packet_rescale_ts(pkt, src_time_base, mVideoStream->time_base);
+
+            ret = av_write_frame(mFmtCtx, pkt);
+            if (ret < 0) {
+                LOGE("av_write_frame error : ret=%d", ret);
+            }
+        }
+
+        av_write_trailer(mFmtCtx);//写文件尾
+
+        LOGI("remux url=%s,pktCount=%lld,skipCount=%lld", url.data(), (int64_t)mAlarm->packets.size(), skipCount);
+
+        return true;
+    }
+
     bool GenerateVideo::run() {
+
+        if (!mAlarm->packets.empty()) {
+            return remux();
+        }
  
-        std::string url = mConfig->rootVideoDir +
-            "/" + mAlarm->controlCode + "-" + std::to_string(getCurTimestamp()) + ".flv";
+        std::string url = genVideoUrl(mConfig, mAlarm, ".flv");
         
         /* 编码合成
          * avformat_alloc_output_context2()
@@ -373,22 +427,34 @@ namespace AVSAnalyzer {
         int ret = -1;
         int receive_packet_count = -1;
 
-        AVSAlarmImage* image;
+        bool spilled = mAlarm->spillSegment != nullptr;// 图片已落盘时直接从映射内存读取
+        size_t imageCount = spilled ? mAlarm->spillImages.size() : mAlarm->images.size();
         int channels = 3;
         int bgrSize = width * height * channels;
         unsigned char* bgr = (unsigned char*)malloc(bgrSize);//创建堆内存
 
-        for (size_t i = 0; i < mAlarm->images.size(); i++)
+        for (size_t i = 0; i < imageCount; i++)
         {
-            // iamge: AVSAlarmImage
-            image = mAlarm->images[i];
+            const unsigned char* jpegData = nullptr;
+            int jpegSize = 0;
+            if (spilled) {
+                jpegData = mAlarm->spillImages[i].data;
+                jpegSize = mAlarm->spillImages[i].size;
+            }
+            else {
+                jpegData = mAlarm->images[i]->getData();
+                jpegSize = mAlarm->images[i]->getSize();
+            }
 
             // 获取解压图片
-            if (genUnCompressImage(image, bgr, bgrSize)) {
+            if (genUnCompressImage(jpegData, jpegSize, bgr, bgrSize)) {
                 //解压缩成功
 
                  // frame_bgr 转  frame_yuv420p, 并转结果存储到frame_yuv420p_buff
-                bgr24ToYuv420p(bgr, width, height, frame_yuv420p_buff);
+                bgr24ToYuv420p(bgr, width * 3, width, height,
+                    frame_yuv420p->data[0], frame_yuv420p->linesize[0],
+                    frame_yuv420p->data[1], frame_yuv420p->linesize[1],
+                    frame_yuv420p->data[2], frame_yuv420p->linesize[2]);
 
 
                 // av_rescale_q_rnd 用于在不同时间基之间进行时间或大小的转
@@ -478,10 +544,27 @@ namespace AVSAnalyzer {
         free(bgr);
         bgr = nullptr;
 
+        // 编码器多线程和B帧会缓存若干帧，写文件尾之前取出全部剩余的pkt，否则报警视频末尾丢帧
+        ret = avcodec_send_frame(mVideoCodecCtx, NULL);
+        if (ret >= 0) {
+            while (avcodec_receive_packet(mVideoCodecCtx, pkt) >= 0) {
+                pkt->stream_index = mVideoIndex;
+                pkt->pos = -1;
+                pkt->duration = frame_yuv420p->pkt_duration;
+
+                int wframe = av_write_frame(mFmtCtx, pkt);
+                if (wframe < 0) {
+                    LOGE("writePkt : wframe=%d", wframe);
+                }
+            }
+        }
+        else {
+            LOGE("avcodec_send_frame flush error : ret=%d", ret);
+        }
+
         av_write_trailer(mFmtCtx);//写文件尾
 
-        av_packet_unref(pkt);
-        pkt = nullptr;
+        av_packet_free(&pkt);
 
 
         av_free(frame_yuv420p_buff);
@@ -13,7 +13,7 @@ namespace AVSAnalyzer {
 	{
 	public:
 		GenerateVideo() = delete;
-		GenerateVideo(Config* config,AVSAlarm* alarm);
+		GenerateVideo(Config* config, AVSAlarm* alarm, int threadCount = 1);// threadCount为编码线程数
 		~GenerateVideo();
 	
 	public:
@@ -21,8 +21,11 @@ namespace AVSAnalyzer {
 	private:
 		Config* mConfig;
 		AVSAlarm* mAlarm;
+		int mThreadCount;
 		bool initCodecCtx(const char * url);
 		void destoryCodecCtx();
+		bool remux();// 报警包含原始pkt时直接封装，不解码也不编码
+		bool initRemuxCtx(const char* url);
 
 		AVFormatContext* mFmtCtx = nullptr;
 		//视频帧
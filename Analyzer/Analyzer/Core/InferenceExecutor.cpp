@@ -0,0 +1,153 @@
+﻿#include "InferenceExecutor.h"
+#include <chrono>
+#include "Analyzer.h"
+#include "AlgorithmWithApi.h"
+#include "Config.h"
+#include "Utils/Log.h"
+
+namespace AVSAnalyzer {
+    InferenceExecutor::InferenceExecutor(Config* config, RequestPool* requestPool, HostBalancer* hostBalancer) :
+        mBatchSize(config->algorithmBatchSize),
+        mBatchWindowMs(config->algorithmBatchWindowMs),
+        mState(true)
+    {
+        mAlgorithm = new AlgorithmWithApi(config, requestPool, hostBalancer);
+        // 批量请求只支持二进制上传
+        if (!mAlgorithm->isBatchable()) {
+            mBatchSize = 1;
+        }
+
+        int threadNum = config->algorithmWorkerNum;
+        if (threadNum < 1) {
+            threadNum = 1;
+        }
+        for (int i = 0; i < threadNum; i++) {
+            std::thread* th = new std::thread(InferenceExecutor::inferenceThread, this);
+            mThreads.push_back(th);
+        }
+        LOGI("threadNum=%d,batchSize=%d,batchWindowMs=%d", threadNum, mBatchSize, mBatchWindowMs);
+    }
+
+    InferenceExecutor::~InferenceExecutor()
+    {
+        mTaskQ_mtx.lock();
+        mState = false;
+        mTaskQ_mtx.unlock();
+        mTaskQ_cv.notify_all();
+
+        for (auto th : mThreads) {
+            th->join();
+            delete th;
+            th = nullptr;
+        }
+        mThreads.clear();
+
+        // 未执行的任务也要通知Analyzer，避免其析构时一直等待
+        InferenceTask task;
+        while (!mTaskQ.empty()) {
+            task = mTaskQ.front();
+            mTaskQ.pop();
+            task.analyzer->cancelInference(task);
+        }
+
+        delete mAlgorithm;
+        mAlgorithm = nullptr;
+        LOGI("batchCount=%lld,taskCount=%lld", mBatchCount, mTaskCount);
+    }
+
+    void InferenceExecutor::submit(const InferenceTask& task) {
+        mTaskQ_mtx.lock();
+        mTaskQ.push(task);
+        mTaskQ_mtx.unlock();
+        mTaskQ_cv.notify_one();
+    }
+    void InferenceExecutor::getStats(int& queueSize, int64_t& batchCount, int64_t& taskCount) {
+        std::unique_lock<std::mutex> lck(mTaskQ_mtx);
+        queueSize = mTaskQ.size();
+        batchCount = mBatchCount;
+        taskCount = mTaskCount;
+    }
+
+    bool InferenceExecutor::getTasks(std::vector<InferenceTask>& tasks) {
+        std::unique_lock<std::mutex> lck(mTaskQ_mtx);
+        mTaskQ_cv.wait(lck, [this] { return !mState || !mTaskQ.empty(); });
+        if (!mState) {
+            return false;
+        }
+        if (mBatchSize > 1 && mTaskQ.size() < mBatchSize) {
+            // 等待其他布控的检测帧，凑满一批或者超过时间窗口后发送
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mBatchWindowMs);
+            mTaskQ_cv.wait_until(lck, deadline, [this] { return !mState || mTaskQ.size() >= mBatchSize; });
+            if (!mState) {
+                return false;
+            }
+        }
+        while (!mTaskQ.empty() && tasks.size() < mBatchSize) {
+            tasks.push_back(mTaskQ.front());
+            mTaskQ.pop();
+        }
+        if (tasks.empty()) {// 已被其他检测线程取走
+            return false;
+        }
+        mBatchCount++;
+        mTaskCount += tasks.size();
+        return true;
+    }
+
+    void InferenceExecutor::handleBatch(std::vector<InferenceTask>& tasks) {
+        // 只有使用算法服务的布控可以合并请求，其他布控（如进程内onnx）逐帧检测
+        std::vector<InferenceTask> batchTasks;
+        for (int i = 0; i < tasks.size(); i++) {
+            if (tasks[i].analyzer->isBatchable()) {
+                batchTasks.push_back(tasks[i]);
+            }
+            else {
+                tasks[i].analyzer->handleInference(tasks[i]);
+            }
+        }
+        tasks.clear();
+        if (batchTasks.size() == 1) {
+            batchTasks[0].analyzer->handleInference(batchTasks[0]);
+            return;
+        }
+        if (batchTasks.empty()) {
+            return;
+        }
+
+        std::vector<VideoFramePtr> frames;
+        for (int i = 0; i < batchTasks.size(); i++) {
+            frames.push_back(batchTasks[i].frame);
+        }
+        std::vector<std::vector<AlgorithmDetectObject>> detects;
+        bool result = mAlgorithm->objectDetectBatch(frames, detects);
+        frames.clear();
+
+        std::vector<AlgorithmDetectObject> empty;
+        for (int i = 0; i < batchTasks.size(); i++) {
+            batchTasks[i].analyzer->handleInferenceResult(batchTasks[i], result, result ? detects[i] : empty);
+        }
+    }
+
+    void InferenceExecutor::inferenceThread(void* arg) {
+        InferenceExecutor* executor = (InferenceExecutor*)arg;
+
+        std::vector<InferenceTask> tasks;
+        while (true)
+        {
+            tasks.clear();
+            if (!executor->getTasks(tasks)) {
+                if (!executor->mState) {
+                    break;
+                }
+                continue;
+            }
+            // handleInference内部会先归还帧，再减少Analyzer的检测中任务数
+            if (tasks.size() == 1) {
+                tasks[0].analyzer->handleInference(tasks[0]);
+            }
+            else {
+                executor->handleBatch(tasks);
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+﻿#ifndef ANALYZER_INFERENCEEXECUTOR_H
+#define ANALYZER_INFERENCEEXECUTOR_H
+#include <thread>
+#include <queue>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "VideoFrame.h"
+
+namespace AVSAnalyzer {
+	class Analyzer;
+	class Algorithm;
+	class Config;
+	class RequestPool;
+	class HostBalancer;
+
+	struct InferenceTask
+	{
+		Analyzer*     analyzer = nullptr;
+		int64_t       frameCount = 0;// 提交检测时的帧序号
+		int64_t       submitTime = 0;// 提交检测时的时间（毫秒）
+		VideoFramePtr frame;         // 送入算法的bgr帧，检测完成后归还帧池
+	};
+
+	/*
+	所有布控共享的算法检测线程池，解码线程只提交检测任务，不等待算法服务返回。
+	每路布控同时在检测中的任务数由Analyzer自己限制。
+	开启批量检测时，检测线程在一个时间窗口内收集多路布控的检测帧，合并为一次请求
+	*/
+	class InferenceExecutor
+	{
+	public:
+		InferenceExecutor(Config* config, RequestPool* requestPool, HostBalancer* hostBalancer);
+		~InferenceExecutor();
+	public:
+		void submit(const InferenceTask& task);
+		void getStats(int& queueSize, int64_t& batchCount, int64_t& taskCount);
+	private:
+		static void inferenceThread(void* arg);
+		bool getTasks(std::vector<InferenceTask>& tasks);
+		void handleBatch(std::vector<InferenceTask>& tasks);
+
+		Algorithm* mAlgorithm;// 批量检测使用，即算法服务
+		int  mBatchSize;    // 一次请求最多合并的帧数，1表示不合并
+		int  mBatchWindowMs;// 收集一批检测帧最多等待的时间
+
+		bool mState;
+		std::vector<std::thread*> mThreads;
+		std::queue<InferenceTask> mTaskQ;
+		std::mutex                mTaskQ_mtx;
+		std::condition_variable   mTaskQ_cv;
+		int64_t mBatchCount = 0;// 已发送的请求数
+		int64_t mTaskCount = 0; // 已检测的帧数
+	};
+}
+#endif //ANALYZER_INFERENCEEXECUTOR_H
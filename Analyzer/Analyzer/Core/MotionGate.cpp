@@ -0,0 +1,126 @@
+﻿#include "MotionGate.h"
+#include <algorithm>
+#include "Control.h"
+#include "Utils/Log.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MG_HAVE_SSE2 1
+#endif
+
+namespace AVSAnalyzer {
+    MotionGate::MotionGate(Control* control, int maxSkipMs) :
+        mControl(control),
+        mMaxSkipMs(maxSkipMs)
+    {
+        mGridWidth = control->videoWidth / BLOCK;
+        mGridHeight = control->videoHeight / BLOCK;
+        mThreshold = control->motionThreshold;
+
+        int gridSize = mGridWidth * mGridHeight;
+        mMask.assign(gridSize, 1);
+        mGrid.assign(gridSize, 0);
+        mRefGrid.assign(gridSize, 0);
+
+        // 屏蔽区域为归一化坐标 x1,y1,x2,y2
+        const std::vector<float>& regions = control->motionMaskRegions;
+        for (int i = 0; i + 3 < regions.size(); i += 4) {
+            int gx1 = int(regions[i] * mGridWidth);
+            int gy1 = int(regions[i + 1] * mGridHeight);
+            int gx2 = int(regions[i + 2] * mGridWidth + 0.999f);
+            int gy2 = int(regions[i + 3] * mGridHeight + 0.999f);
+            for (int gy = std::max(gy1, 0); gy < std::min(gy2, mGridHeight); gy++) {
+                for (int gx = std::max(gx1, 0); gx < std::min(gx2, mGridWidth); gx++) {
+                    mMask[gy * mGridWidth + gx] = 0;
+                }
+            }
+        }
+        int validCount = 0;
+        for (int i = 0; i < gridSize; i++) {
+            validCount += mMask[i];
+        }
+        mMinChanged = int(validCount * control->motionRatio);
+        if (mMinChanged < 1) {
+            mMinChanged = 1;
+        }
+
+        LOGI("grid=%dx%d,valid=%d,threshold=%d,minChanged=%d,maxSkipMs=%d",
+            mGridWidth, mGridHeight, validCount, mThreshold, mMinChanged, mMaxSkipMs);
+    }
+
+    MotionGate::~MotionGate()
+    {
+    }
+
+    void MotionGate::computeGrid(const unsigned char* luma, int stride, unsigned char* grid) {
+        for (int gy = 0; gy < mGridHeight; gy++) {
+            const unsigned char* rows = luma + gy * BLOCK * stride;
+            unsigned char* out = grid + gy * mGridWidth;
+            int gx = 0;
+#ifdef MG_HAVE_SSE2
+            // 每次处理两个块（16像素宽），_mm_sad_epu8与0求差得到每8个字节的和
+            const __m128i zero = _mm_setzero_si128();
+            for (; gx + 2 <= mGridWidth; gx += 2) {
+                __m128i sum = _mm_setzero_si128();
+                const unsigned char* p = rows + gx * BLOCK;
+                for (int r = 0; r < BLOCK; r++) {
+                    __m128i v = _mm_loadu_si128((const __m128i*)(p + r * stride));
+                    sum = _mm_add_epi64(sum, _mm_sad_epu8(v, zero));
+                }
+                out[gx] = (unsigned char)(_mm_cvtsi128_si32(sum) >> 6);
+                out[gx + 1] = (unsigned char)(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)) >> 6);
+            }
+#endif
+            for (; gx < mGridWidth; gx++) {
+                const unsigned char* p = rows + gx * BLOCK;
+                int sum = 0;
+                for (int r = 0; r < BLOCK; r++) {
+                    for (int c = 0; c < BLOCK; c++) {
+                        sum += p[r * stride + c];
+                    }
+                }
+                out[gx] = (unsigned char)(sum >> 6);
+            }
+        }
+    }
+
+    bool MotionGate::check(const unsigned char* yuv, int64_t now) {
+        if (mGridWidth == 0 || mGridHeight == 0) {
+            return true;
+        }
+        computeGrid(yuv, mControl->videoWidth, mGrid.data());
+
+        bool pass = false;
+        if (!mHasRef || (mMaxSkipMs > 0 && now - mLastPassTime >= mMaxSkipMs)) {
+            pass = true;
+        }
+        else {
+            int changed = 0;
+            int gridSize = mGridWidth * mGridHeight;
+            for (int i = 0; i < gridSize; i++) {
+                int diff = (int)mGrid[i] - (int)mRefGrid[i];
+                if (mMask[i] && (diff > mThreshold || diff < -mThreshold)) {
+                    if (++changed >= mMinChanged) {
+                        pass = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (pass) {
+            // 以送检帧作为下一次比较的参考帧，缓慢的变化也会逐渐累积到阈值
+            mRefGrid.swap(mGrid);
+            mHasRef = true;
+            mLastPassTime = now;
+        }
+        else {
+            mSkipCount++;
+        }
+        return pass;
+    }
+
+    int64_t MotionGate::getSkipCount() {
+        return mSkipCount;
+    }
+}
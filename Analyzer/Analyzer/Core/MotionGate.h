@@ -0,0 +1,42 @@
+﻿#ifndef ANALYZER_MOTIONGATE_H
+#define ANALYZER_MOTIONGATE_H
+#include <stdint.h>
+#include <vector>
+
+namespace AVSAnalyzer {
+	struct Control;
+
+	/*
+	检测前的画面变化判断：
+	将亮度平面按8x8像素块求平均值得到缩小的亮度图，与上一次送检帧的亮度图比较，
+	变化超过阈值的块所占比例达到要求时才认为画面发生了变化。屏蔽区域内的块不参与比较
+	*/
+	class MotionGate
+	{
+	public:
+		static const int BLOCK = 8;
+
+		MotionGate(Control* control, int maxSkipMs);
+		~MotionGate();
+	public:
+		// yuv为yuv420p帧（只读取亮度平面），返回true表示需要送检
+		bool check(const unsigned char* yuv, int64_t now);
+		int64_t getSkipCount();
+	private:
+		void computeGrid(const unsigned char* luma, int stride, unsigned char* grid);
+
+		Control* mControl;
+		int  mGridWidth;
+		int  mGridHeight;
+		int  mThreshold;  // 单个块亮度平均值变化的阈值
+		int  mMinChanged; // 变化的块数达到该值认为画面发生了变化
+		int  mMaxSkipMs;  // 连续跳过检测的最长时间，超过后强制送检
+		std::vector<unsigned char> mMask;     // 1表示参与比较
+		std::vector<unsigned char> mGrid;     // 当前帧
+		std::vector<unsigned char> mRefGrid;  // 上一次送检帧
+		bool    mHasRef = false;
+		int64_t mLastPassTime = 0;
+		int64_t mSkipCount = 0;
+	};
+}
+#endif //ANALYZER_MOTIONGATE_H
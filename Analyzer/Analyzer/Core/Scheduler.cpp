@@ -5,43 +5,195 @@
 #include "GenerateAlarm.h"
 #include "GenerateVideo.h"
 #include "Utils/Log.h"
+#include "Utils/Common.h"
+#include "Utils/RequestPool.h"
+#include "Utils/HostBalancer.h"
+#include "InferenceExecutor.h"
+#include "AlgorithmWithOnnx.h"
+#include "StageExecutor.h"
+#include "AlarmImagePool.h"
+#include "AlarmSpill.h"
 
 namespace AVSAnalyzer {
-    Scheduler::Scheduler(Config* config) :mConfig(config), mState(false),
-        mLoopAlarmThread(nullptr)
+    Scheduler::Scheduler(Config* config) :mConfig(config), mState(false)
     {
         LOGI("");
+        RequestPool::globalInit();
+        mRequestPool = new RequestPool(config->algorithmApiMaxConnPerHost, 3000);
+        mHostBalancer = new HostBalancer(config->algorithmApiHosts, config->algorithmApiEjectErrors,
+            config->algorithmApiEjectBaseMs, config->algorithmApiEjectMaxMs);
+        mInferenceExecutor = new InferenceExecutor(config, mRequestPool, mHostBalancer);
+        mStageExecutor = new StageExecutor(config->stageWorkerNum, config->stageMaxItemsPerRun);
+        mAlarmImagePool = new AlarmImagePool((int64_t)config->alarmImagePoolBudgetMB * 1024 * 1024);
+        mAlarmSpill = nullptr;
+
+        // 报警视频生成线程共享cpu核数，每个编码器的线程数随线程池大小调整
+        mAlarmEncodeThreads = config->alarmEncodeThreads;
+        if (mAlarmEncodeThreads <= 0) {
+            int workerNum = config->alarmWorkerNum > 0 ? config->alarmWorkerNum : 1;
+            mAlarmEncodeThreads = std::thread::hardware_concurrency() / workerNum;
+        }
+        if (mAlarmEncodeThreads <= 0) {
+            mAlarmEncodeThreads = 1;
+        }
+
+        mDecodeThreadBudget = config->videoDecodeThreadBudget;
+        if (mDecodeThreadBudget <= 0) {
+            mDecodeThreadBudget = std::thread::hardware_concurrency();
+        }
+        if (mDecodeThreadBudget <= 0) {
+            mDecodeThreadBudget = 4;
+        }
+
+        mOnnxAlgorithm = nullptr;
+        if (!config->algorithmOnnxModel.empty()) {
+            AlgorithmWithOnnx* onnx = new AlgorithmWithOnnx(config);
+            if (onnx->test()) {
+                mOnnxAlgorithm = onnx;
+            }
+            else {
+                LOGE("load onnx model error: %s", config->algorithmOnnxModel.data());
+                delete onnx;
+            }
+        }
+
+        if (config->alarmSpill) {
+            mAlarmSpill = new AlarmSpill(config->rootVideoDir + "/spill",
+                (int64_t)config->alarmSpillSegmentMB * 1024 * 1024, (int64_t)config->alarmSpillMaxMB * 1024 * 1024);
+            // 上次运行未生成的报警重新加入队列
+            std::vector<AVSAlarm*> alarms;
+            mAlarmSpill->recover(alarms);
+            for (auto alarm : alarms) {
+                addAlarm(alarm);
+            }
+        }
     }
 
     Scheduler::~Scheduler()
     {
         LOGI("");
 
+        setState(false);
+        for (auto th : mAlarmThreads) {
+            th->join();
+            delete th;
+        }
+        mAlarmThreads.clear();
         clearAlarmQueue();
-        mLoopAlarmThread->join();
-        delete mLoopAlarmThread;
-        mLoopAlarmThread = nullptr;
+
+        if (mAlarmSpill) {
+            delete mAlarmSpill;
+            mAlarmSpill = nullptr;
+        }
+
+        delete mStageExecutor;
+        mStageExecutor = nullptr;
+
+        delete mAlarmImagePool;
+        mAlarmImagePool = nullptr;
+
+        delete mInferenceExecutor;
+        mInferenceExecutor = nullptr;
+
+        // 检测线程已全部退出，可以释放onnx模型
+        if (mOnnxAlgorithm) {
+            delete mOnnxAlgorithm;
+            mOnnxAlgorithm = nullptr;
+        }
+
+        delete mHostBalancer;
+        mHostBalancer = nullptr;
+
+        delete mRequestPool;
+        mRequestPool = nullptr;
+        RequestPool::globalCleanup();
     }
 
     Config* Scheduler::getConfig() {
         return mConfig;
     }
+    RequestPool* Scheduler::getRequestPool() {
+        return mRequestPool;
+    }
+    InferenceExecutor* Scheduler::getInferenceExecutor() {
+        return mInferenceExecutor;
+    }
+    HostBalancer* Scheduler::getHostBalancer() {
+        return mHostBalancer;
+    }
+    StageExecutor* Scheduler::getStageExecutor() {
+        return mStageExecutor;
+    }
+    Algorithm* Scheduler::getOnnxAlgorithm() {
+        return mOnnxAlgorithm;
+    }
+
+    void Scheduler::addCheckFpsTarget(float fps) {
+        std::unique_lock<std::mutex> lck(mCheckFps_mtx);
+        mCheckFpsTargetSum += fps;
+        mCheckFpsScale = (mConfig->checkFpsBudget > 0 && mCheckFpsTargetSum > mConfig->checkFpsBudget) ?
+            mConfig->checkFpsBudget / mCheckFpsTargetSum : 1;
+    }
+    void Scheduler::removeCheckFpsTarget(float fps) {
+        std::unique_lock<std::mutex> lck(mCheckFps_mtx);
+        mCheckFpsTargetSum -= fps;
+        if (mCheckFpsTargetSum < 0) {
+            mCheckFpsTargetSum = 0;
+        }
+        mCheckFpsScale = (mConfig->checkFpsBudget > 0 && mCheckFpsTargetSum > mConfig->checkFpsBudget) ?
+            mConfig->checkFpsBudget / mCheckFpsTargetSum : 1;
+    }
+    float Scheduler::getCheckFpsScale() {
+        std::unique_lock<std::mutex> lck(mCheckFps_mtx);
+        return mCheckFpsScale;
+    }
+
+    int Scheduler::acquireDecodeThreads(int num) {
+        std::unique_lock<std::mutex> lck(mDecodeThreads_mtx);
+        int available = mDecodeThreadBudget - mDecodeThreadsInUse;
+        if (num > available) {
+            num = available;
+        }
+        if (num < 1) {
+            num = 1;// 预算用完后每路布控仍然保留一个解码线程
+        }
+        mDecodeThreadsInUse += num;
+        return num;
+    }
+    void Scheduler::releaseDecodeThreads(int num) {
+        std::unique_lock<std::mutex> lck(mDecodeThreads_mtx);
+        mDecodeThreadsInUse -= num;
+        if (mDecodeThreadsInUse < 0) {
+            mDecodeThreadsInUse = 0;
+        }
+    }
 
     void Scheduler::loop() {
 
         LOGI("Loop Start");
 
-        mLoopAlarmThread = new std::thread(Scheduler::loopAlarmThread, this);
-        mLoopAlarmThread->native_handle();
-
-        int64_t l = 0;
+        int alarmWorkerNum = mConfig->alarmWorkerNum > 0 ? mConfig->alarmWorkerNum : 1;
+        for (int i = 0; i < alarmWorkerNum; i++)
+        {
+            std::thread* th = new std::thread(Scheduler::loopAlarmThread, this);
+            th->native_handle();
+            mAlarmThreads.push_back(th);
+        }
+        LOGI("alarmWorkerNum=%d,alarmEncodeThreads=%d", alarmWorkerNum, mAlarmEncodeThreads);
 
-        // 清除
+        // 有待删除的执行器时立即处理，否则每个周期做一次例行维护
+        int tickMs = mConfig->schedulerTickMs > 0 ? mConfig->schedulerTickMs : 1000;
+        int64_t lastTick = getCurTime();
         while (mState)
         {
-            ++l;
-            handleDeleteExecutor();
+            int64_t waitMs = tickMs - (getCurTime() - lastTick);
+            handleDeleteExecutor(waitMs > 0 ? waitMs : 0);
 
+            int64_t now = getCurTime();
+            if (now - lastTick >= tickMs) {
+                lastTick = now;
+                handleHousekeeping();
+            }
         }
         LOGI("Loop End");
     }
@@ -138,7 +290,14 @@ namespace AVSAnalyzer {
 
     }
     void Scheduler::setState(bool state) {
+        mTobeDeletedExecutorQ_mtx.lock();
+        mAlarmQ_mtx.lock();
         mState = state;
+        mAlarmQ_mtx.unlock();
+        mTobeDeletedExecutorQ_mtx.unlock();
+        // 唤醒事件循环和报警线程，使其及时退出
+        mTobeDeletedExecutorQ_cv.notify_all();
+        mAlarmQ_cv.notify_all();
     }
     bool Scheduler::getState() {
         return mState;
@@ -181,9 +340,9 @@ namespace AVSAnalyzer {
         if (mExecutorMap.end() != f) {
             ControlExecutor* executor = f->second;
             // executor 添加到待删除队列start
-            std::unique_lock <std::mutex> lck(mTobeDeletedExecutorQ_mtx);
+            mTobeDeletedExecutorQ_mtx.lock();
             mTobeDeletedExecutorQ.push(executor);
-            //mTobeDeletedExecutorQ_cv.notify_all();
+            mTobeDeletedExecutorQ_mtx.unlock();
             mTobeDeletedExecutorQ_cv.notify_one();
             // executor 添加到待删除队列end
             result = mExecutorMap.erase(control->code) != 0;
@@ -203,14 +362,21 @@ namespace AVSAnalyzer {
         return executor;
     }
 
-    void Scheduler::handleDeleteExecutor() {
+    void Scheduler::handleDeleteExecutor(int64_t timeoutMs) {
 
+        // 带条件等待，在等待之前加入队列的执行器也不会被遗漏
+        std::queue<ControlExecutor*> executors;
         std::unique_lock <std::mutex> lck(mTobeDeletedExecutorQ_mtx);
-        mTobeDeletedExecutorQ_cv.wait(lck);
+        mTobeDeletedExecutorQ_cv.wait_for(lck, std::chrono::milliseconds(timeoutMs), [this] {
+            return !mState || !mTobeDeletedExecutorQ.empty();
+            });
+        executors.swap(mTobeDeletedExecutorQ);
+        lck.unlock();
 
-        while (!mTobeDeletedExecutorQ.empty()) {
-            ControlExecutor* executor = mTobeDeletedExecutorQ.front();
-            mTobeDeletedExecutorQ.pop();
+        // 析构执行器需要等待线程退出，不能持有队列的锁，否则会阻塞removeExecutor
+        while (!executors.empty()) {
+            ControlExecutor* executor = executors.front();
+            executors.pop();
 
             LOGI("code=%s,streamUrl=%s", executor->mControl->code.data(), executor->mControl->streamUrl.data());
 
@@ -220,97 +386,215 @@ namespace AVSAnalyzer {
         }
 
     }
+    void Scheduler::handleHousekeeping() {
+        // 没有新帧的布控（如断流重连中）也定期刷新统计信息
+        mExecutorMapMtx.lock();
+        for (auto f = mExecutorMap.begin(); f != mExecutorMap.end(); ++f)
+        {
+            f->second->updateStats();
+        }
+        mExecutorMapMtx.unlock();
+
+        int alarmWorkerNum = 0;
+        int alarmQSize = 0;
+        int64_t alarmHandledCount, alarmDropCount, alarmAvgWaitMs, alarmMaxWaitMs, alarmAvgGenerateMs, alarmMaxGenerateMs;
+        getAlarmStats(alarmWorkerNum, alarmQSize, alarmHandledCount, alarmDropCount,
+            alarmAvgWaitMs, alarmMaxWaitMs, alarmAvgGenerateMs, alarmMaxGenerateMs);
+        if (alarmQSize > 0) {
+            int64_t budgetBytes, allocatedBytes, usingBytes, hits, misses, evictCount, rejectCount;
+            int instanceCount;
+            mAlarmImagePool->getStats(budgetBytes, allocatedBytes, usingBytes, instanceCount, hits, misses, evictCount, rejectCount);
+            LOGI("待报警=%d,已报警=%lld,丢弃报警=%lld,图片池已分配=%lld(bytes),使用中=%lld(bytes),rejectCount=%lld",
+                alarmQSize, alarmHandledCount, alarmDropCount, allocatedBytes, usingBytes, rejectCount);
+        }
+    }
     void Scheduler::handleLoopAlarm() {
         AVSAlarm* alarm = nullptr;
         int alarmQSize;
 
         bool ret = false;
         while (true) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-
+            // 有报警时立即处理，不再每条报警间隔1秒
             ret = getAlarm(alarm, alarmQSize);
             if (ret) {
+                int64_t t1 = getCurTime();
 
-                LOGI("发送（1）条报警，剩余待报警=%d,mAlarmImageInstanceCount=%d",
-                    alarmQSize, mAlarmImageInstanceCount);
-
-                GenerateVideo gen(mConfig,alarm);
+                GenerateVideo gen(mConfig, alarm, mAlarmEncodeThreads);
                 gen.run();
 
-                //释放Alarm的图片资源
-                for (int i = 0; i < alarm->images.size(); i++)
-                {
-                    AVSAlarmImage* image = alarm->images[i];
-                    if (image) {
-                        giveBackAlarmImage(image);
-                    }
-
-                }
-                alarm->images.clear();
+                int64_t t2 = getCurTime();
+                int64_t waitMs = t1 - alarm->addTime;
+                int64_t generateMs = t2 - t1;
+                LOGI("生成（1）条报警，code=%s,frames=%d,wait=%lld(ms),generate=%lld(ms),剩余待报警=%d",
+                    alarm->controlCode.data(), (int)(alarm->images.size() + alarm->packets.size() + alarm->spillImages.size()),
+                    waitMs, generateMs, alarmQSize);
 
-                delete alarm;
+                releaseAlarm(alarm);
                 alarm = nullptr;
+
+                mAlarmQ_mtx.lock();
+                mAlarmHandledCount++;
+                mAlarmWaitSum += waitMs;
+                mAlarmGenerateSum += generateMs;
+                if (waitMs > mAlarmWaitMax) {
+                    mAlarmWaitMax = waitMs;
+                }
+                if (generateMs > mAlarmGenerateMax) {
+                    mAlarmGenerateMax = generateMs;
+                }
+                mAlarmQ_mtx.unlock();
             }
+            else {
+                break;// 调度器已停止
+            }
+        }
+    }
+    void Scheduler::releaseAlarm(AVSAlarm* alarm, bool keepSpill) {
+        if (alarm->spillSegment && !keepSpill) {
+            mAlarmSpill->release(alarm);
         }
+        //释放Alarm的图片资源
+        for (int i = 0; i < alarm->images.size(); i++)
+        {
+            AVSAlarmImage* image = alarm->images[i];
+            if (image) {
+                giveBackAlarmImage(image);
+            }
 
+        }
+        alarm->images.clear();
 
-    
+        delete alarm;
     }
     void Scheduler::loopAlarmThread(void* arg) {
         Scheduler* scheduler = (Scheduler*)arg;
         scheduler->handleLoopAlarm();
     }
     void Scheduler::addAlarm(AVSAlarm* alarm) {
+        AVSAlarm* dropAlarm = nullptr;
+        alarm->addTime = getCurTime();
+
+        // 图片池内存紧张时将图片落盘，立即归还图片，生成报警视频时从映射内存读取
+        if (mAlarmSpill && !alarm->spillSegment && !alarm->images.empty() &&
+            mAlarmImagePool->getUsingBytes() >= (int64_t)mConfig->alarmSpillThresholdMB * 1024 * 1024) {
+            if (mAlarmSpill->spill(alarm)) {
+                for (size_t i = 0; i < alarm->images.size(); i++)
+                {
+                    giveBackAlarmImage(alarm->images[i]);
+                }
+                alarm->images.clear();
+            }
+        }
+
         mAlarmQ_mtx.lock();
-        mAlarmQ.push(alarm);
+        std::deque<AVSAlarm*>& q = mAlarmQMap[alarm->controlCode];
+        if (q.empty()) {
+            mAlarmControlOrder.push_back(alarm->controlCode);
+        }
+        q.push_back(alarm);
+        mAlarmQSize++;
+
+        if (mConfig->alarmQueueCapacity > 0 && mAlarmQSize > mConfig->alarmQueueCapacity) {
+            // 丢弃待生成报警最多的布控中最早的报警，其他布控的报警不受影响
+            auto maxIt = mAlarmQMap.begin();
+            for (auto it = mAlarmQMap.begin(); it != mAlarmQMap.end(); ++it)
+            {
+                if (it->second.size() > maxIt->second.size()) {
+                    maxIt = it;
+                }
+            }
+            dropAlarm = maxIt->second.front();
+            maxIt->second.pop_front();
+            mAlarmQSize--;
+            mAlarmDropCount++;
+            if (maxIt->second.empty()) {
+                for (auto it = mAlarmControlOrder.begin(); it != mAlarmControlOrder.end(); ++it)
+                {
+                    if (*it == maxIt->first) {
+                        mAlarmControlOrder.erase(it);
+                        break;
+                    }
+                }
+                mAlarmQMap.erase(maxIt);
+            }
+        }
         mAlarmQ_mtx.unlock();
-    }
-
-
-    AVSAlarmImage* Scheduler::gainAlarmImage() {
-
-        AVSAlarmImage* image = nullptr;
-        mAlarmImageQ_mtx.lock();
+        mAlarmQ_cv.notify_one();
 
-        if (mAlarmImageQ.empty()) {
-            mAlarmImageQ_mtx.unlock();
-
-            image = AVSAlarmImage::Create(1920,1080,3);
-
-            mAlarmImageInstanceCount++;
-        }
-        else {
-            image = mAlarmImageQ.front();
-            mAlarmImageQ.pop();
-            mAlarmImageQ_mtx.unlock();
+        if (dropAlarm) {
+            LOGE("alarm queue is full, drop alarm code=%s", dropAlarm->controlCode.data());
+            releaseAlarm(dropAlarm);
         }
+    }
+    void Scheduler::getAlarmStats(int& workerNum, int& queueSize, int64_t& handledCount, int64_t& dropCount,
+        int64_t& avgWaitMs, int64_t& maxWaitMs, int64_t& avgGenerateMs, int64_t& maxGenerateMs) {
+        std::unique_lock<std::mutex> lck(mAlarmQ_mtx);
+        workerNum = mConfig->alarmWorkerNum > 0 ? mConfig->alarmWorkerNum : 1;
+        queueSize = mAlarmQSize;
+        handledCount = mAlarmHandledCount;
+        dropCount = mAlarmDropCount;
+        avgWaitMs = mAlarmHandledCount > 0 ? mAlarmWaitSum / mAlarmHandledCount : 0;
+        maxWaitMs = mAlarmWaitMax;
+        avgGenerateMs = mAlarmHandledCount > 0 ? mAlarmGenerateSum / mAlarmHandledCount : 0;
+        maxGenerateMs = mAlarmGenerateMax;
+    }
+
 
-        return image;
+    AVSAlarmImage* Scheduler::gainAlarmImage(int size) {
+        return mAlarmImagePool->gain(size);
     }
     void Scheduler::giveBackAlarmImage(AVSAlarmImage* image) {
-
-        mAlarmImageQ_mtx.lock();
-        mAlarmImageQ.push(image);
-        mAlarmImageQ_mtx.unlock();
+        mAlarmImagePool->giveBack(image);
+    }
+    AlarmImagePool* Scheduler::getAlarmImagePool() {
+        return mAlarmImagePool;
+    }
+    AlarmSpill* Scheduler::getAlarmSpill() {
+        return mAlarmSpill;
     }
 
     bool Scheduler::getAlarm(AVSAlarm*& alarm, int& alarmQSize) {
-        mAlarmQ_mtx.lock();
-
-        if (!mAlarmQ.empty()) {
-            alarm = mAlarmQ.front();
-            mAlarmQ.pop();
-            alarmQSize = mAlarmQ.size();
-            mAlarmQ_mtx.unlock();
+        // 等待到有报警或调度器停止，返回false表示调度器已停止
+        std::unique_lock<std::mutex> lck(mAlarmQ_mtx);
+        mAlarmQ_cv.wait(lck, [this] { return !mState || mAlarmQSize > 0; });
+
+        if (mState && mAlarmQSize > 0) {
+            // 轮询布控，每次取一个布控最早的报警，该布控还有报警时排到最后
+            std::string code = mAlarmControlOrder.front();
+            mAlarmControlOrder.pop_front();
+            auto it = mAlarmQMap.find(code);
+            alarm = it->second.front();
+            it->second.pop_front();
+            if (it->second.empty()) {
+                mAlarmQMap.erase(it);
+            }
+            else {
+                mAlarmControlOrder.push_back(code);
+            }
+            mAlarmQSize--;
+            alarmQSize = mAlarmQSize;
             return true;
-
         }
         else {
-            alarmQSize = 0;
-            mAlarmQ_mtx.unlock();
+            alarmQSize = mAlarmQSize;
             return false;
         }
     }
-    void Scheduler::clearAlarmQueue() {}
+    void Scheduler::clearAlarmQueue() {
+        std::vector<AVSAlarm*> alarms;
+        mAlarmQ_mtx.lock();
+        for (auto it = mAlarmQMap.begin(); it != mAlarmQMap.end(); ++it)
+        {
+            alarms.insert(alarms.end(), it->second.begin(), it->second.end());
+        }
+        mAlarmQMap.clear();
+        mAlarmControlOrder.clear();
+        mAlarmQSize = 0;
+        mAlarmQ_mtx.unlock();
+
+        for (auto alarm : alarms) {
+            releaseAlarm(alarm, true);
+        }
+    }
 
 }
@@ -4,6 +4,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <thread>
 
@@ -13,6 +14,13 @@ namespace AVSAnalyzer {
 	struct Control;
 	struct AVSAlarmImage;
 	struct AVSAlarm;
+	class RequestPool;
+	class InferenceExecutor;
+	class HostBalancer;
+	class Algorithm;
+	class StageExecutor;
+	class AlarmImagePool;
+	class AlarmSpill;
 
 	class Scheduler
 	{
@@ -23,16 +31,35 @@ namespace AVSAnalyzer {
 		~Scheduler();
 	public:
 		Config* getConfig();
+		RequestPool* getRequestPool();// 算法服务请求共享的连接池
+		InferenceExecutor* getInferenceExecutor();// 所有布控共享的算法检测线程池
+		HostBalancer* getHostBalancer();// 算法服务地址的负载均衡
+		StageExecutor* getStageExecutor();// 所有布控共享的解码分析、报警、推流编码线程池
+		Algorithm* getOnnxAlgorithm();// 所有布控共享的onnx模型，未配置或加载失败时为nullptr
 		void loop();
 
 		void setState(bool state);
 		bool getState();
 
-		void addAlarm(AVSAlarm* alarm);
+		void addAlarm(AVSAlarm* alarm);// 队列已满时丢弃待生成报警最多的布控中最早的报警
+		void getAlarmStats(int& workerNum, int& queueSize, int64_t& handledCount, int64_t& dropCount,
+			int64_t& avgWaitMs, int64_t& maxWaitMs, int64_t& avgGenerateMs, int64_t& maxGenerateMs);
 
-		AVSAlarmImage* gainAlarmImage();// 从队列池获取一个压缩图片的实例
-		void giveBackAlarmImage(AVSAlarmImage* image);//将一个压缩图片的实例归还到队列池
-		int mAlarmImageInstanceCount = 0;
+		// 全局检测帧率预算 start
+		void  addCheckFpsTarget(float fps);
+		void  removeCheckFpsTarget(float fps);
+		float getCheckFpsScale();// 目标帧率之和超过预算时的缩放比例
+		// 全局检测帧率预算 end
+
+		// 全局解码线程预算 start
+		int  acquireDecodeThreads(int num);// 返回实际分配的线程数，预算不足时少分配，至少为1
+		void releaseDecodeThreads(int num);
+		// 全局解码线程预算 end
+
+		AVSAlarmImage* gainAlarmImage(int size);// 从图片池获取一个容量不小于size的压缩图片实例，超出内存预算时返回nullptr
+		void giveBackAlarmImage(AVSAlarmImage* image);//将一个压缩图片的实例归还到图片池
+		AlarmImagePool* getAlarmImagePool();
+		AlarmSpill* getAlarmSpill();// 未开启落盘时为nullptr
 
 		// ApiServer 对应的函数 start
 		int  apiControls(std::vector<Control*>& controls);
@@ -43,6 +70,21 @@ namespace AVSAnalyzer {
 
 	private:
 		Config* mConfig;
+		RequestPool* mRequestPool;
+		InferenceExecutor* mInferenceExecutor;
+		HostBalancer* mHostBalancer;
+		Algorithm* mOnnxAlgorithm;
+		StageExecutor* mStageExecutor;
+		AlarmImagePool* mAlarmImagePool;
+		AlarmSpill* mAlarmSpill;
+
+		int        mDecodeThreadBudget;
+		int        mDecodeThreadsInUse = 0;
+		std::mutex mDecodeThreads_mtx;
+
+		float      mCheckFpsTargetSum = 0;
+		float      mCheckFpsScale = 1;
+		std::mutex mCheckFps_mtx;
 
 		bool  mState;
 
@@ -57,20 +99,30 @@ namespace AVSAnalyzer {
 		std::queue<ControlExecutor*> mTobeDeletedExecutorQ;
 		std::mutex                   mTobeDeletedExecutorQ_mtx;
 		std::condition_variable      mTobeDeletedExecutorQ_cv;
-		void handleDeleteExecutor();
+		void handleDeleteExecutor(int64_t timeoutMs);// 最多等待timeoutMs毫秒，删除队列中所有的执行器
+		void handleHousekeeping();// 事件循环每个周期的例行维护
 
 		//报警处理 start
-		std::thread* mLoopAlarmThread;
+		std::vector<std::thread*> mAlarmThreads;// 生成报警视频的线程池
+		int  mAlarmEncodeThreads;               // 每个报警视频编码使用的线程数
 		static void loopAlarmThread(void* arg);
 		void handleLoopAlarm();
-		std::queue<AVSAlarm*> mAlarmQ;
-		std::mutex            mAlarmQ_mtx;
+		void releaseAlarm(AVSAlarm* alarm, bool keepSpill = false);// 归还报警的图片并释放报警，keepSpill为true时保留落盘的报警，下次启动时恢复
+		// 每个布控一个队列，按布控轮询取报警，一个布控的大量报警不会阻塞其他布控
+		std::map<std::string, std::deque<AVSAlarm*>> mAlarmQMap;// <control.code,待生成的报警>
+		std::deque<std::string> mAlarmControlOrder;             // 有待生成报警的布控，按轮询顺序
+		int                     mAlarmQSize = 0;                // 所有布控待生成的报警数
+		std::mutex              mAlarmQ_mtx;
+		std::condition_variable mAlarmQ_cv;
+		int64_t               mAlarmHandledCount = 0;
+		int64_t               mAlarmDropCount = 0;
+		int64_t               mAlarmWaitSum = 0;    // 报警在队列中等待的总时长（毫秒）
+		int64_t               mAlarmWaitMax = 0;
+		int64_t               mAlarmGenerateSum = 0;// 生成报警视频的总时长（毫秒）
+		int64_t               mAlarmGenerateMax = 0;
 		bool getAlarm(AVSAlarm*& alarm, int& alarmQSize);
 		void clearAlarmQueue();
 
-		std::queue<AVSAlarmImage* > mAlarmImageQ;
-		std::mutex                  mAlarmImageQ_mtx;
-
 		//报警处理 end
 
 	};
@@ -20,6 +20,12 @@
 #include "Scheduler.h"
 #include "Utils/Log.h"
 #include "Utils/Common.h"
+#include "Utils/RequestPool.h"
+#include "Utils/HostBalancer.h"
+#include "InferenceExecutor.h"
+#include "StageExecutor.h"
+#include "AlarmImagePool.h"
+#include "AlarmSpill.h"
 
 using namespace AVSAnalyzer;
 
@@ -129,6 +135,7 @@ void api_index(struct evhttp_request* req, void* arg) {
 }
 
 void api_health(struct evhttp_request* req, void* arg) {
+    Scheduler* scheduler = (Scheduler*)arg;
     int result_code = 0;
     std::string result_msg = "error";
 
@@ -136,10 +143,140 @@ void api_health(struct evhttp_request* req, void* arg) {
     result_code = 1000;
     result_msg = "current service health";
 
+    // 算法服务连接池
+    std::vector<RequestPoolStats> requestPoolStats;
+    scheduler->getRequestPool()->getStats(requestPoolStats);
+    Json::Value result_request_pool;
+    Json::Value result_request_pool_item;
+    for (int i = 0; i < requestPoolStats.size(); i++)
+    {
+        result_request_pool_item["host"] = requestPoolStats[i].host.data();
+        result_request_pool_item["inUse"] = requestPoolStats[i].inUse;
+        result_request_pool_item["idle"] = requestPoolStats[i].idle;
+        result_request_pool_item["created"] = (Json::Int64)requestPoolStats[i].created;
+        result_request_pool_item["reused"] = (Json::Int64)requestPoolStats[i].reused;
+        result_request_pool_item["waits"] = (Json::Int64)requestPoolStats[i].waits;
+        result_request_pool_item["timeouts"] = (Json::Int64)requestPoolStats[i].timeouts;
+        result_request_pool_item["errors"] = (Json::Int64)requestPoolStats[i].errors;
+        result_request_pool.append(result_request_pool_item);
+    }
+
+    // 算法服务地址
+    std::vector<HostStats> hostStats;
+    scheduler->getHostBalancer()->getStats(hostStats);
+    Json::Value result_hosts;
+    for (int i = 0; i < hostStats.size(); i++)
+    {
+        Json::Value result_hosts_item;
+        result_hosts_item["host"] = hostStats[i].host.data();
+        result_hosts_item["healthy"] = hostStats[i].healthy;
+        result_hosts_item["outstanding"] = hostStats[i].outstanding;
+        result_hosts_item["ewmaLatency"] = hostStats[i].ewmaLatency;
+        result_hosts_item["requests"] = (Json::Int64)hostStats[i].requests;
+        result_hosts_item["errors"] = (Json::Int64)hostStats[i].errors;
+        result_hosts_item["ejectCount"] = hostStats[i].ejectCount;
+
+        // 耗时直方图，le为区间上限（毫秒），-1表示大于最大上限
+        Json::Value result_histogram;
+        for (int b = 0; b < HOST_LATENCY_BUCKET_NUM; b++)
+        {
+            Json::Value result_histogram_item;
+            result_histogram_item["le"] = b < HOST_LATENCY_BUCKET_NUM - 1 ? HOST_LATENCY_BUCKETS[b] : -1;
+            result_histogram_item["count"] = (Json::Int64)hostStats[i].latencyHistogram[b];
+            result_histogram.append(result_histogram_item);
+        }
+        result_hosts_item["latencyHistogram"] = result_histogram;
+        result_hosts.append(result_hosts_item);
+    }
+
+    // 算法检测线程池
+    int inferenceQueueSize = 0;
+    int64_t inferenceBatchCount = 0;
+    int64_t inferenceTaskCount = 0;
+    scheduler->getInferenceExecutor()->getStats(inferenceQueueSize, inferenceBatchCount, inferenceTaskCount);
+    Json::Value result_inference;
+    result_inference["queueSize"] = inferenceQueueSize;
+    result_inference["batchCount"] = (Json::Int64)inferenceBatchCount;
+    result_inference["taskCount"] = (Json::Int64)inferenceTaskCount;
+
+    // 布控阶段线程池
+    int stageThreadNum = 0;
+    int stageQueueSize = 0;
+    int64_t stageRunCount = 0;
+    int64_t stageStealCount = 0;
+    scheduler->getStageExecutor()->getStats(stageThreadNum, stageQueueSize, stageRunCount, stageStealCount);
+    Json::Value result_stage;
+    result_stage["threadNum"] = stageThreadNum;
+    result_stage["queueSize"] = stageQueueSize;
+    result_stage["runCount"] = (Json::Int64)stageRunCount;
+    result_stage["stealCount"] = (Json::Int64)stageStealCount;
+
+    // 报警队列
+    int alarmWorkerNum = 0;
+    int alarmQueueSize = 0;
+    int64_t alarmHandledCount = 0;
+    int64_t alarmDropCount = 0;
+    int64_t alarmAvgWaitMs = 0;
+    int64_t alarmMaxWaitMs = 0;
+    int64_t alarmAvgGenerateMs = 0;
+    int64_t alarmMaxGenerateMs = 0;
+    scheduler->getAlarmStats(alarmWorkerNum, alarmQueueSize, alarmHandledCount, alarmDropCount,
+        alarmAvgWaitMs, alarmMaxWaitMs, alarmAvgGenerateMs, alarmMaxGenerateMs);
+    Json::Value result_alarm;
+    result_alarm["workerNum"] = alarmWorkerNum;
+    result_alarm["queueSize"] = alarmQueueSize;
+    result_alarm["handledCount"] = (Json::Int64)alarmHandledCount;
+    result_alarm["dropCount"] = (Json::Int64)alarmDropCount;
+    result_alarm["avgWaitMs"] = (Json::Int64)alarmAvgWaitMs;
+    result_alarm["maxWaitMs"] = (Json::Int64)alarmMaxWaitMs;
+    result_alarm["avgGenerateMs"] = (Json::Int64)alarmAvgGenerateMs;
+    result_alarm["maxGenerateMs"] = (Json::Int64)alarmMaxGenerateMs;
+
+    // 报警图片池
+    int64_t imagePoolBudgetBytes = 0;
+    int64_t imagePoolAllocatedBytes = 0;
+    int64_t imagePoolUsingBytes = 0;
+    int     imagePoolInstanceCount = 0;
+    int64_t imagePoolHits = 0;
+    int64_t imagePoolMisses = 0;
+    int64_t imagePoolEvictCount = 0;
+    int64_t imagePoolRejectCount = 0;
+    scheduler->getAlarmImagePool()->getStats(imagePoolBudgetBytes, imagePoolAllocatedBytes, imagePoolUsingBytes,
+        imagePoolInstanceCount, imagePoolHits, imagePoolMisses, imagePoolEvictCount, imagePoolRejectCount);
+    Json::Value result_alarm_image_pool;
+    result_alarm_image_pool["budgetBytes"] = (Json::Int64)imagePoolBudgetBytes;
+    result_alarm_image_pool["allocatedBytes"] = (Json::Int64)imagePoolAllocatedBytes;
+    result_alarm_image_pool["usingBytes"] = (Json::Int64)imagePoolUsingBytes;
+    result_alarm_image_pool["instanceCount"] = imagePoolInstanceCount;
+    result_alarm_image_pool["hits"] = (Json::Int64)imagePoolHits;
+    result_alarm_image_pool["misses"] = (Json::Int64)imagePoolMisses;
+    result_alarm_image_pool["evictCount"] = (Json::Int64)imagePoolEvictCount;
+    result_alarm_image_pool["rejectCount"] = (Json::Int64)imagePoolRejectCount;
 
     Json::Value result;
     result["msg"] = result_msg;
     result["code"] = result_code;
+    result["requestPool"] = result_request_pool;
+    result["alarm"] = result_alarm;
+    result["alarmImagePool"] = result_alarm_image_pool;
+    if (scheduler->getAlarmSpill()) {
+        int spillSegmentCount = 0;
+        int64_t spillMappedBytes = 0;
+        int64_t spillCount = 0;
+        int64_t spillFailCount = 0;
+        int64_t spillRecoverCount = 0;
+        scheduler->getAlarmSpill()->getStats(spillSegmentCount, spillMappedBytes, spillCount, spillFailCount, spillRecoverCount);
+        Json::Value result_alarm_spill;
+        result_alarm_spill["segmentCount"] = spillSegmentCount;
+        result_alarm_spill["mappedBytes"] = (Json::Int64)spillMappedBytes;
+        result_alarm_spill["spillCount"] = (Json::Int64)spillCount;
+        result_alarm_spill["failCount"] = (Json::Int64)spillFailCount;
+        result_alarm_spill["recoverCount"] = (Json::Int64)spillRecoverCount;
+        result["alarmSpill"] = result_alarm_spill;
+    }
+    result["inference"] = result_inference;
+    result["stage"] = result_stage;
+    result["algorithmHosts"] = result_hosts;
 
     struct evbuffer* buff = evbuffer_new();
     evbuffer_add_printf(buff, "%s", result.toStyledString().c_str());
@@ -183,8 +320,40 @@ void api_controls(struct evhttp_request* req, void* arg) {
                 result_data_item["streamUrl"] = controls[i]->streamUrl.data();
                 result_data_item["pushStream"] = controls[i]->pushStream;
                 result_data_item["pushStreamUrl"] = controls[i]->pushStreamUrl.data();
+                result_data_item["pushYuvDirect"] = controls[i]->pushYuvDirect;
                 result_data_item["behaviorCode"] = controls[i]->behaviorCode.data();
+                result_data_item["pullMode"] = controls[i]->pullMode.data();
+                result_data_item["videoDecoder"] = controls[i]->videoDecoder.data();
+                result_data_item["decodeThreads"] = controls[i]->decodeThreads;
+                result_data_item["videoDecodeThreads"] = controls[i]->videoDecodeThreads;
+                result_data_item["decodeSkipMode"] = controls[i]->decodeSkipMode.data();
+                result_data_item["decodeMode"] = controls[i]->decodeMode.data();
+                result_data_item["decodeGopInterval"] = controls[i]->decodeGopInterval;
+                result_data_item["decodeSkipPktCount"] = (Json::Int64)controls[i]->decodeSkipPktCount;
                 result_data_item["checkFps"] = controls[i]->checkFps;
+                result_data_item["targetCheckFps"] = controls[i]->targetCheckFps;
+                result_data_item["effectiveCheckFps"] = controls[i]->effectiveCheckFps;
+                result_data_item["algorithmInputSize"] = controls[i]->algorithmInputSize;
+                result_data_item["checkWidth"] = controls[i]->checkWidth;
+                result_data_item["checkHeight"] = controls[i]->checkHeight;
+                result_data_item["algorithmMaxInFlight"] = controls[i]->algorithmMaxInFlight;
+                result_data_item["algorithmBackend"] = controls[i]->algorithmBackend.data();
+                result_data_item["alarmVideoMode"] = controls[i]->alarmVideoMode.data();
+                result_data_item["checkInFlight"] = controls[i]->checkInFlight;
+                result_data_item["checkSkipCount"] = (Json::Int64)controls[i]->checkSkipCount;
+                result_data_item["checkLatency"] = (Json::Int64)controls[i]->checkLatency;
+                result_data_item["motionGate"] = controls[i]->motionGate;
+                result_data_item["motionSkipCount"] = (Json::Int64)controls[i]->motionSkipCount;
+                result_data_item["framePoolCapacity"] = controls[i]->framePoolCapacity;
+                result_data_item["framePoolHits"] = (Json::Int64)controls[i]->framePoolHits;
+                result_data_item["framePoolMisses"] = (Json::Int64)controls[i]->framePoolMisses;
+                result_data_item["framePoolHighWater"] = controls[i]->framePoolHighWater;
+                result_data_item["videoPktQSize"] = controls[i]->videoPktQSize;
+                result_data_item["videoPktQDropCount"] = (Json::Int64)controls[i]->videoPktQDropCount;
+                result_data_item["pushFrameQSize"] = controls[i]->pushFrameQSize;
+                result_data_item["pushFrameQDropCount"] = (Json::Int64)controls[i]->pushFrameQDropCount;
+                result_data_item["alarmFrameQSize"] = controls[i]->alarmFrameQSize;
+                result_data_item["alarmFrameQDropCount"] = (Json::Int64)controls[i]->alarmFrameQDropCount;
                 result_data_item["executorStartTimestamp"] = executorStartTimestamp;
                 result_data_item["liveMilliseconds"] = curTimestamp - executorStartTimestamp;
 
@@ -246,6 +415,8 @@ void api_control(struct evhttp_request* req, void* arg) {
         if (control) {
             result_control["code"] = control->code;
             result_control["checkFps"] = control->checkFps;
+            result_control["targetCheckFps"] = control->targetCheckFps;
+            result_control["effectiveCheckFps"] = control->effectiveCheckFps;
 
             result_code = 1000;
             result_msg = "success";
@@ -306,9 +477,64 @@ void api_control_add(struct evhttp_request* req, void* arg) {
         if (root["pushStreamUrl"].isString()) {
             control.pushStreamUrl = root["pushStreamUrl"].asString();
         }
+        if (root["pushYuvDirect"].isBool()) {
+            control.pushYuvDirect = root["pushYuvDirect"].asBool();
+        }
         if (root["behaviorCode"].isString()) {
             control.behaviorCode = root["behaviorCode"].asString();
         }
+        if (root["pullMode"].isString()) {
+            control.pullMode = root["pullMode"].asString();
+        }
+        if (root["decodeThreads"].isInt()) {
+            control.decodeThreads = root["decodeThreads"].asInt();
+        }
+        if (root["decodeSkipMode"].isString()) {
+            control.decodeSkipMode = root["decodeSkipMode"].asString();
+        }
+        if (root["decodeMode"].isString()) {
+            control.decodeMode = root["decodeMode"].asString();
+        }
+        if (root["decodeGopInterval"].isInt()) {
+            control.decodeGopInterval = root["decodeGopInterval"].asInt();
+        }
+        if (root["algorithmInputSize"].isInt()) {
+            control.algorithmInputSize = root["algorithmInputSize"].asInt();
+        }
+        if (root["algorithmMaxInFlight"].isInt()) {
+            control.algorithmMaxInFlight = root["algorithmMaxInFlight"].asInt();
+        }
+        if (root["algorithmBackend"].isString()) {
+            control.algorithmBackend = root["algorithmBackend"].asString();
+        }
+        if (root["alarmVideoMode"].isString()) {
+            control.alarmVideoMode = root["alarmVideoMode"].asString();
+        }
+        if (root["targetCheckFps"].isNumeric()) {
+            control.targetCheckFps = root["targetCheckFps"].asFloat();
+        }
+        if (root["motionGate"].isBool()) {
+            control.motionGate = root["motionGate"].asBool();
+        }
+        if (root["motionThreshold"].isInt()) {
+            control.motionThreshold = root["motionThreshold"].asInt();
+        }
+        if (root["motionRatio"].isNumeric()) {
+            control.motionRatio = root["motionRatio"].asFloat();
+        }
+        // 格式 [[x1,y1,x2,y2],...]，归一化坐标
+        if (root["motionMaskRegions"].isArray()) {
+            for (auto region : root["motionMaskRegions"]) {
+                if (region.isArray() && region.size() == 4) {
+                    for (auto v : region) {
+                        control.motionMaskRegions.push_back(v.asFloat());
+                    }
+                }
+                else {
+                    control.motionMaskRegions.push_back(0);// 格式错误，由validateAdd返回错误
+                }
+            }
+        }
         if (control.validateAdd(result_msg)) {
             scheduler->apiControlAdd(&control, result_code, result_msg);
         }
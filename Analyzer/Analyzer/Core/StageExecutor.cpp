@@ -0,0 +1,195 @@
+﻿#include "StageExecutor.h"
+#include <chrono>
+#include "Utils/Log.h"
+
+namespace AVSAnalyzer {
+    static thread_local StageExecutor* tExecutor = nullptr;// 当前线程所属的StageExecutor，非工作线程为nullptr
+    static thread_local int tWorkerIndex = -1;// 当前线程在tExecutor中的序号
+
+    Stage::Stage(const char* name, Func run, Func hasInput, void* arg) :
+        mName(name),
+        mRun(run),
+        mHasInput(hasInput),
+        mArg(arg),
+        mScheduled(false),
+        mStopped(false)
+    {
+
+    }
+    Stage::~Stage()
+    {
+
+    }
+    const char* Stage::getName() {
+        return mName;
+    }
+
+    StageExecutor::StageExecutor(int threadNum, int maxItemsPerRun) :
+        mMaxItemsPerRun(maxItemsPerRun > 0 ? maxItemsPerRun : 1),
+        mState(true),
+        mNextWorker(0),
+        mQueued(0),
+        mRunCount(0),
+        mStealCount(0)
+    {
+        if (threadNum <= 0) {
+            threadNum = std::thread::hardware_concurrency();
+        }
+        if (threadNum <= 0) {
+            threadNum = 4;
+        }
+        for (int i = 0; i < threadNum; i++) {
+            mWorkers.push_back(new Worker);
+        }
+        for (int i = 0; i < threadNum; i++) {
+            std::thread* th = new std::thread(StageExecutor::workerThread, this, i);
+            mThreads.push_back(th);
+        }
+        LOGI("threadNum=%d,maxItemsPerRun=%d", threadNum, mMaxItemsPerRun);
+    }
+
+    StageExecutor::~StageExecutor()
+    {
+        mWork_mtx.lock();
+        mState = false;
+        mWork_mtx.unlock();
+        mWork_cv.notify_all();
+
+        for (auto th : mThreads) {
+            th->join();
+            delete th;
+            th = nullptr;
+        }
+        mThreads.clear();
+
+        for (auto worker : mWorkers) {
+            delete worker;
+        }
+        mWorkers.clear();
+        LOGI("runCount=%lld,stealCount=%lld", (long long)mRunCount, (long long)mStealCount);
+    }
+
+    void StageExecutor::schedule(Stage* stage) {
+        if (stage->mScheduled.exchange(true)) {
+            return;// 已在排队或正在执行，执行结束时会检查输入队列
+        }
+        enqueue(stage, false);
+    }
+
+    void StageExecutor::remove(Stage* stage) {
+        // 调用前必须保证生产者不再调度该Stage
+        std::unique_lock<std::mutex> lck(mWork_mtx);
+        stage->mStopped = true;
+        mIdle_cv.wait(lck, [stage] { return !stage->mScheduled; });
+    }
+
+    void StageExecutor::getStats(int& threadNum, int& queueSize, int64_t& runCount, int64_t& stealCount) {
+        threadNum = mWorkers.size();
+        queueSize = mQueued;
+        runCount = mRunCount;
+        stealCount = mStealCount;
+    }
+
+    void StageExecutor::enqueue(Stage* stage, bool requeue) {
+        // 工作线程调度同一线程池的Stage（如解码后的报警）放入自己的队列，数据还在缓存中
+        int index = tExecutor == this ? tWorkerIndex : -1;
+        if (index < 0) {
+            index = mNextWorker++ % mWorkers.size();
+        }
+        Worker* worker = mWorkers[index];
+        worker->mtx.lock();
+        if (requeue) {
+            // 自己从队尾取，放在队首才能让其他Stage先执行；空闲线程也会优先窃取到它
+            worker->q.push_front(stage);
+        }
+        else {
+            worker->q.push_back(stage);
+        }
+        worker->mtx.unlock();
+
+        mWork_mtx.lock();
+        mQueued++;
+        mWork_mtx.unlock();
+        mWork_cv.notify_one();
+    }
+
+    Stage* StageExecutor::take(int index) {
+        Stage* stage = nullptr;
+        Worker* worker = mWorkers[index];
+        worker->mtx.lock();
+        if (!worker->q.empty()) {
+            stage = worker->q.back();
+            worker->q.pop_back();
+        }
+        worker->mtx.unlock();
+
+        for (int i = 1; !stage && i < mWorkers.size(); i++) {
+            Worker* other = mWorkers[(index + i) % mWorkers.size()];
+            other->mtx.lock();
+            if (!other->q.empty()) {
+                stage = other->q.front();
+                other->q.pop_front();
+                mStealCount++;
+            }
+            other->mtx.unlock();
+        }
+        if (stage) {
+            mQueued--;
+        }
+        return stage;
+    }
+
+    void StageExecutor::runStage(Stage* stage) {
+        int count = 0;
+        if (!stage->mStopped) {
+            while (count < mMaxItemsPerRun && stage->mRun(stage->mArg)) {
+                count++;
+            }
+        }
+        mRunCount++;
+
+        std::unique_lock<std::mutex> lck(mWork_mtx);
+        bool requeue = false;
+        if (!stage->mStopped && stage->mHasInput(stage->mArg)) {
+            // 还有数据，保持已调度状态重新排队，让其他布控的Stage先执行
+            requeue = true;
+        }
+        else {
+            stage->mScheduled = false;
+            // 生产者可能在检查输入之后、清除标记之前入队并调用schedule（看到已调度直接返回），
+            // 清除标记后再检查一次，由成功设置标记的一方负责排队，避免数据留在队列中无人处理
+            if (!stage->mStopped && stage->mHasInput(stage->mArg) && !stage->mScheduled.exchange(true)) {
+                requeue = true;
+            }
+        }
+        // 解锁后不能再访问stage（重新排队的除外），remove返回后stage可能已被释放
+        lck.unlock();
+        if (requeue) {
+            enqueue(stage, true);
+        }
+        else {
+            mIdle_cv.notify_all();
+        }
+    }
+
+    void StageExecutor::workerThread(StageExecutor* executor, int index) {
+        tExecutor = executor;
+        tWorkerIndex = index;
+
+        while (true)
+        {
+            Stage* stage = executor->take(index);
+            if (stage) {
+                executor->runStage(stage);
+                continue;
+            }
+            std::unique_lock<std::mutex> lck(executor->mWork_mtx);
+            executor->mWork_cv.wait_for(lck, std::chrono::milliseconds(100), [executor] {
+                return !executor->mState || executor->mQueued > 0;
+                });
+            if (!executor->mState) {
+                break;
+            }
+        }
+    }
+}
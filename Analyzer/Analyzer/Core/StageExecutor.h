@@ -0,0 +1,78 @@
+﻿#ifndef ANALYZER_STAGEEXECUTOR_H
+#define ANALYZER_STAGEEXECUTOR_H
+#include <thread>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+namespace AVSAnalyzer {
+	class StageExecutor;
+
+	/*
+	布控的一个处理阶段（解码分析、报警、推流），输入队列有数据时由StageExecutor调度执行。
+	同一个Stage同一时间只会在一个线程中执行，因此阶段内部的状态不需要加锁
+	*/
+	class Stage
+	{
+	public:
+		friend class StageExecutor;
+		typedef bool (*Func)(void* arg);
+
+		// run：从输入队列取一个数据处理，不阻塞，队列为空时返回false
+		// hasInput：输入队列是否还有数据
+		Stage(const char* name, Func run, Func hasInput, void* arg);
+		~Stage();
+	public:
+		const char* getName();
+	private:
+		const char* mName;
+		Func  mRun;
+		Func  mHasInput;
+		void* mArg;
+		std::atomic<bool> mScheduled; // 已在某个线程的队列中或正在执行
+		std::atomic<bool> mStopped;   // 已从StageExecutor移除，不再执行
+	};
+
+	/*
+	所有布控共享的阶段线程池，线程数固定（默认cpu核数），替代每路布控每个阶段一个线程。
+	每个线程有自己的队列，空闲时从其他线程的队列窃取；
+	每次调度一个Stage最多处理maxItemsPerRun个数据后重新排队，避免单路布控长期占用线程。
+	拉流的av_read_frame和推流的av_interleaved_write_frame会阻塞，仍然由每路布控自己的线程执行
+	*/
+	class StageExecutor
+	{
+	public:
+		StageExecutor(int threadNum, int maxItemsPerRun);
+		~StageExecutor();
+	public:
+		void schedule(Stage* stage);// 输入队列有新数据时调用
+		void remove(Stage* stage);  // 等待正在执行的该Stage结束，之后不能再调度该Stage
+		void getStats(int& threadNum, int& queueSize, int64_t& runCount, int64_t& stealCount);
+	private:
+		struct Worker
+		{
+			std::deque<Stage*> q;
+			std::mutex         mtx;
+		};
+		static void workerThread(StageExecutor* executor, int index);
+		void   enqueue(Stage* stage, bool requeue);// requeue为true时放在队首，自己队列中的其他Stage先执行
+		Stage* take(int index);// 先取自己队列的队尾，再从其他队列的队首窃取
+		void   runStage(Stage* stage);
+
+		int  mMaxItemsPerRun;
+		bool mState;
+		std::vector<Worker*>      mWorkers;
+		std::vector<std::thread*> mThreads;
+		std::atomic<unsigned int> mNextWorker;
+		std::atomic<int>          mQueued;// 所有线程队列中的Stage数
+
+		std::mutex              mWork_mtx;
+		std::condition_variable mWork_cv;  // 有新的Stage排队
+		std::condition_variable mIdle_cv;  // 有Stage执行结束
+		std::atomic<int64_t> mRunCount;
+		std::atomic<int64_t> mStealCount;
+	};
+}
+#endif //ANALYZER_STAGEEXECUTOR_H
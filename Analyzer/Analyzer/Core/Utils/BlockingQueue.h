@@ -0,0 +1,237 @@
+﻿#ifndef ANALYZER_BLOCKINGQUEUE_H
+#define ANALYZER_BLOCKINGQUEUE_H
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <chrono>
+
+namespace AVSAnalyzer {
+
+    // 队列已满时的处理策略
+    enum QueueDropPolicy
+    {
+        QUEUE_DROP_OLDEST = 0,     // 丢弃最旧的元素
+        QUEUE_DROP_NON_KEYFRAME,   // 丢弃到下一个关键帧为止，保证解码不花屏
+        QUEUE_BLOCK,               // 阻塞生产者，超时后丢弃当前元素（超时时间为0时一直等待，直到有空间或队列停止）
+    };
+
+    inline QueueDropPolicy parseQueueDropPolicy(const std::string& policy, QueueDropPolicy defaultPolicy) {
+        if (policy == "dropOldest") {
+            return QUEUE_DROP_OLDEST;
+        }
+        else if (policy == "dropNonKeyframe") {
+            return QUEUE_DROP_NON_KEYFRAME;
+        }
+        else if (policy == "block") {
+            return QUEUE_BLOCK;
+        }
+        return defaultPolicy;
+    }
+
+    // 有界阻塞队列，生产者和消费者通过条件变量唤醒，不再轮询
+    template <typename T>
+    class BlockingQueue
+    {
+    public:
+        typedef std::function<void(T&)> ReleaseFunc;         // 释放被丢弃的元素
+        typedef std::function<bool(const T&)> KeyframeFunc;  // 判断元素是否为关键帧
+        typedef std::function<void()> NotifyFunc;            // 元素入队后通知消费者（如调度消费者所在的Stage）
+
+        BlockingQueue(int capacity, QueueDropPolicy policy,
+            ReleaseFunc release = nullptr, KeyframeFunc isKeyframe = nullptr) :
+            mCapacity(capacity > 0 ? capacity : 1),
+            mPolicy(policy),
+            mRelease(release),
+            mIsKeyframe(isKeyframe)
+        {
+            if (QUEUE_DROP_NON_KEYFRAME == mPolicy && !mIsKeyframe) {
+                mPolicy = QUEUE_DROP_OLDEST;
+            }
+        }
+        ~BlockingQueue() {
+            clear();
+        }
+        BlockingQueue(const BlockingQueue&) = delete;
+        BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    public:
+        // 返回false表示item已被丢弃（并已释放）
+        bool push(T& item) {
+            std::unique_lock <std::mutex> lck(mMtx);
+
+            if (mStopped) {
+                drop(item);
+                return false;
+            }
+            if (mWaitKeyframe) {
+                if (!mIsKeyframe(item)) {
+                    drop(item);
+                    return false;
+                }
+                mWaitKeyframe = false;
+            }
+
+            if ((int)mQ.size() >= mCapacity) {
+                switch (mPolicy)
+                {
+                case QUEUE_BLOCK: {
+                    auto hasSpaceOrStopped = [this] {
+                        return mStopped || (int)mQ.size() < mCapacity;
+                    };
+                    if (mBlockTimeoutMs > 0) {
+                        mNotFull_cv.wait_for(lck, std::chrono::milliseconds(mBlockTimeoutMs), hasSpaceOrStopped);
+                    }
+                    else {
+                        mNotFull_cv.wait(lck, hasSpaceOrStopped);
+                    }
+                    if (mStopped || (int)mQ.size() >= mCapacity) {
+                        drop(item);
+                        return false;
+                    }
+                    break;
+                }
+                case QUEUE_DROP_NON_KEYFRAME: {
+                    size_t keyIndex = 0;
+                    for (size_t i = 1; i < mQ.size(); i++) {
+                        if (mIsKeyframe(mQ[i])) {
+                            keyIndex = i;
+                            break;
+                        }
+                    }
+                    if (keyIndex > 0) {
+                        // 丢弃队首到下一个关键帧之间的元素
+                        dropFront(keyIndex);
+                    }
+                    else if (mIsKeyframe(item)) {
+                        // 新的关键帧到来，队列中的旧数据全部丢弃
+                        dropFront(mQ.size());
+                    }
+                    else {
+                        // 队列中没有后续关键帧，丢弃当前元素并等待下一个关键帧
+                        drop(item);
+                        mWaitKeyframe = true;
+                        return false;
+                    }
+                    break;
+                }
+                default: {
+                    dropFront(mQ.size() - mCapacity + 1);
+                    break;
+                }
+                }
+            }
+
+            mQ.push_back(item);
+            lck.unlock();
+            mNotEmpty_cv.notify_one();
+            if (mNotify) {
+                mNotify();
+            }
+            return true;
+        }
+
+        // 不等待，返回false表示队列为空
+        bool tryPop(T& item, int& qSize) {
+            return pop(item, qSize, 0);
+        }
+
+        // 最多等待timeoutMs毫秒，返回false表示队列为空
+        bool pop(T& item, int& qSize, int timeoutMs) {
+            std::unique_lock <std::mutex> lck(mMtx);
+            if (!mNotEmpty_cv.wait_for(lck, std::chrono::milliseconds(timeoutMs), [this] { return !mQ.empty(); })) {
+                qSize = 0;
+                return false;
+            }
+            item = mQ.front();
+            mQ.pop_front();
+            qSize = mQ.size();
+            lck.unlock();
+            mNotFull_cv.notify_one();
+            return true;
+        }
+
+        // 唤醒阻塞的生产者，之后push的元素都被丢弃，退出前调用避免生产者一直等待
+        void stop() {
+            std::unique_lock <std::mutex> lck(mMtx);
+            mStopped = true;
+            lck.unlock();
+            mNotFull_cv.notify_all();
+        }
+
+        void clear() {
+            std::unique_lock <std::mutex> lck(mMtx);
+            while (!mQ.empty()) {
+                if (mRelease) {
+                    mRelease(mQ.front());
+                }
+                mQ.pop_front();
+            }
+            mWaitKeyframe = false;
+            lck.unlock();
+            mNotFull_cv.notify_all();
+        }
+
+        int size() {
+            std::lock_guard <std::mutex> lck(mMtx);
+            return mQ.size();
+        }
+        int64_t getDropCount() {
+            std::lock_guard <std::mutex> lck(mMtx);
+            return mDropCount;
+        }
+        // 必须在生产者开始push之前设置
+        void setNotify(NotifyFunc notify) {
+            mNotify = notify;
+        }
+        int getCapacity() {
+            return mCapacity;
+        }
+        QueueDropPolicy getPolicy() {
+            return mPolicy;
+        }
+        void setPolicy(QueueDropPolicy policy) {
+            std::lock_guard <std::mutex> lck(mMtx);
+            if (QUEUE_DROP_NON_KEYFRAME == policy && !mIsKeyframe) {
+                policy = QUEUE_DROP_OLDEST;
+            }
+            mPolicy = policy;
+            mWaitKeyframe = false;
+        }
+        // QUEUE_BLOCK时阻塞生产者的最长时间，0表示一直等待
+        void setBlockTimeout(int timeoutMs) {
+            std::lock_guard <std::mutex> lck(mMtx);
+            mBlockTimeoutMs = timeoutMs > 0 ? timeoutMs : 0;
+        }
+    private:
+        void drop(T& item) {
+            if (mRelease) {
+                mRelease(item);
+            }
+            mDropCount++;
+        }
+        void dropFront(size_t count) {
+            for (size_t i = 0; i < count && !mQ.empty(); i++) {
+                drop(mQ.front());
+                mQ.pop_front();
+            }
+        }
+
+        std::deque<T>           mQ;
+        std::mutex              mMtx;
+        std::condition_variable mNotEmpty_cv;
+        std::condition_variable mNotFull_cv;
+
+        int             mCapacity;
+        QueueDropPolicy mPolicy;
+        ReleaseFunc     mRelease;
+        KeyframeFunc    mIsKeyframe;
+        NotifyFunc      mNotify;
+        bool            mWaitKeyframe = false;// 已丢弃非关键帧，等待下一个关键帧
+        int64_t         mDropCount = 0;
+        int             mBlockTimeoutMs = 1000;// 阻塞生产者的最长时间，0表示一直等待
+        bool            mStopped = false;      // 已停止，唤醒并丢弃之后push的元素
+    };
+}
+#endif //ANALYZER_BLOCKINGQUEUE_H
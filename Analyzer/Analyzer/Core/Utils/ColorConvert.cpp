@@ -0,0 +1,267 @@
+﻿#include "ColorConvert.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CC_HAVE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CC_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define CC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CC_TARGET_SSE41
+#define CC_TARGET_AVX2
+#endif
+
+namespace AVSAnalyzer {
+
+    // BT.601 limited range，与之前的标量实现系数一致，结果不会超出[0,255]，不需要clip
+    static inline unsigned char lumaOf(int r, int g, int b) {
+        return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+    static inline unsigned char chromaUOf(int r, int g, int b) {
+        return (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    }
+    static inline unsigned char chromaVOf(int r, int g, int b) {
+        return (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    // 处理两行像素 [x, width)，bgr1/y1可以与bgr0/y0相同（高度为奇数时的最后一行）
+    static void rowPairScalar(const unsigned char* bgr0, const unsigned char* bgr1,
+        unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int x, int width) {
+
+        for (; x < width; x += 2) {
+            int x1 = (x + 1 < width) ? x + 1 : x;
+            const unsigned char* p00 = bgr0 + x * 3;
+            const unsigned char* p01 = bgr0 + x1 * 3;
+            const unsigned char* p10 = bgr1 + x * 3;
+            const unsigned char* p11 = bgr1 + x1 * 3;
+
+            y0[x] = lumaOf(p00[2], p00[1], p00[0]);
+            y0[x1] = lumaOf(p01[2], p01[1], p01[0]);
+            y1[x] = lumaOf(p10[2], p10[1], p10[0]);
+            y1[x1] = lumaOf(p11[2], p11[1], p11[0]);
+
+            int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+            int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+            int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+            u[x >> 1] = chromaUOf(r, g, b);
+            v[x >> 1] = chromaVOf(r, g, b);
+        }
+    }
+
+#ifdef CC_HAVE_X86
+    // 16个bgr像素（48字节）拆分为b、g、r三个平面
+    CC_TARGET_SSE41 static inline void deinterleaveBgr16(const unsigned char* p, __m128i& b, __m128i& g, __m128i& r) {
+        const __m128i a0 = _mm_loadu_si128((const __m128i*)p);
+        const __m128i a1 = _mm_loadu_si128((const __m128i*)(p + 16));
+        const __m128i a2 = _mm_loadu_si128((const __m128i*)(p + 32));
+
+        const __m128i mB0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i mB1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+        const __m128i mB2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+        const __m128i mG0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i mG1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+        const __m128i mG2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+        const __m128i mR0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i mR1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+        const __m128i mR2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+        b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mB0), _mm_shuffle_epi8(a1, mB1)), _mm_shuffle_epi8(a2, mB2));
+        g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mG0), _mm_shuffle_epi8(a1, mG1)), _mm_shuffle_epi8(a2, mG2));
+        r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mR0), _mm_shuffle_epi8(a1, mR1)), _mm_shuffle_epi8(a2, mR2));
+    }
+
+    // 8个16位像素的亮度，中间结果最大56228，无符号16位不会溢出
+    CC_TARGET_SSE41 static inline __m128i lumaSse(__m128i r, __m128i g, __m128i b) {
+        __m128i y = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+    }
+    // 色度，中间结果在[-28560, 28688]之间，有符号16位不会溢出
+    CC_TARGET_SSE41 static inline __m128i chromaSse(__m128i c0, __m128i c1, __m128i c2, short k0, short k1, short k2) {
+        __m128i c = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(c0, _mm_set1_epi16(k0)), _mm_mullo_epi16(c1, _mm_set1_epi16(k1))),
+            _mm_add_epi16(_mm_mullo_epi16(c2, _mm_set1_epi16(k2)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+    }
+
+    CC_TARGET_SSE41 static int rowPairSse41(const unsigned char* bgr0, const unsigned char* bgr1,
+        unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int width) {
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i b0, g0, r0, b1, g1, r1;
+            deinterleaveBgr16(bgr0 + x * 3, b0, g0, r0);
+            deinterleaveBgr16(bgr1 + x * 3, b1, g1, r1);
+
+            __m128i b0l = _mm_unpacklo_epi8(b0, zero), b0h = _mm_unpackhi_epi8(b0, zero);
+            __m128i g0l = _mm_unpacklo_epi8(g0, zero), g0h = _mm_unpackhi_epi8(g0, zero);
+            __m128i r0l = _mm_unpacklo_epi8(r0, zero), r0h = _mm_unpackhi_epi8(r0, zero);
+            __m128i b1l = _mm_unpacklo_epi8(b1, zero), b1h = _mm_unpackhi_epi8(b1, zero);
+            __m128i g1l = _mm_unpacklo_epi8(g1, zero), g1h = _mm_unpackhi_epi8(g1, zero);
+            __m128i r1l = _mm_unpacklo_epi8(r1, zero), r1h = _mm_unpackhi_epi8(r1, zero);
+
+            _mm_storeu_si128((__m128i*)(y0 + x), _mm_packus_epi16(lumaSse(r0l, g0l, b0l), lumaSse(r0h, g0h, b0h)));
+            _mm_storeu_si128((__m128i*)(y1 + x), _mm_packus_epi16(lumaSse(r1l, g1l, b1l), lumaSse(r1h, g1h, b1h)));
+
+            // 2x2像素块求和后取平均
+            __m128i sb = _mm_hadd_epi16(_mm_add_epi16(b0l, b1l), _mm_add_epi16(b0h, b1h));
+            __m128i sg = _mm_hadd_epi16(_mm_add_epi16(g0l, g1l), _mm_add_epi16(g0h, g1h));
+            __m128i sr = _mm_hadd_epi16(_mm_add_epi16(r0l, r1l), _mm_add_epi16(r0h, r1h));
+            __m128i ab = _mm_srli_epi16(_mm_add_epi16(sb, two), 2);
+            __m128i ag = _mm_srli_epi16(_mm_add_epi16(sg, two), 2);
+            __m128i ar = _mm_srli_epi16(_mm_add_epi16(sr, two), 2);
+
+            __m128i cu = chromaSse(ar, ag, ab, -38, -74, 112);
+            __m128i cv = chromaSse(ar, ag, ab, 112, -94, -18);
+            _mm_storel_epi64((__m128i*)(u + (x >> 1)), _mm_packus_epi16(cu, cu));
+            _mm_storel_epi64((__m128i*)(v + (x >> 1)), _mm_packus_epi16(cv, cv));
+        }
+        return x;
+    }
+
+    CC_TARGET_AVX2 static inline __m256i lumaAvx2(__m256i r, __m256i g, __m256i b) {
+        __m256i y = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)), _mm256_mullo_epi16(g, _mm256_set1_epi16(129))),
+            _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(25)), _mm256_set1_epi16(128)));
+        return _mm256_add_epi16(_mm256_srli_epi16(y, 8), _mm256_set1_epi16(16));
+    }
+    CC_TARGET_AVX2 static inline __m256i chromaAvx2(__m256i c0, __m256i c1, __m256i c2, short k0, short k1, short k2) {
+        __m256i c = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(c0, _mm256_set1_epi16(k0)), _mm256_mullo_epi16(c1, _mm256_set1_epi16(k1))),
+            _mm256_add_epi16(_mm256_mullo_epi16(c2, _mm256_set1_epi16(k2)), _mm256_set1_epi16(128)));
+        return _mm256_add_epi16(_mm256_srai_epi16(c, 8), _mm256_set1_epi16(128));
+    }
+
+    CC_TARGET_AVX2 static int rowPairAvx2(const unsigned char* bgr0, const unsigned char* bgr1,
+        unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int width) {
+
+        const __m256i two = _mm256_set1_epi16(2);
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m128i b0a, g0a, r0a, b0b, g0b, r0b, b1a, g1a, r1a, b1b, g1b, r1b;
+            deinterleaveBgr16(bgr0 + x * 3, b0a, g0a, r0a);
+            deinterleaveBgr16(bgr0 + x * 3 + 48, b0b, g0b, r0b);
+            deinterleaveBgr16(bgr1 + x * 3, b1a, g1a, r1a);
+            deinterleaveBgr16(bgr1 + x * 3 + 48, b1b, g1b, r1b);
+
+            // a: 第0~15个像素，b: 第16~31个像素
+            __m256i B0a = _mm256_cvtepu8_epi16(b0a), B0b = _mm256_cvtepu8_epi16(b0b);
+            __m256i G0a = _mm256_cvtepu8_epi16(g0a), G0b = _mm256_cvtepu8_epi16(g0b);
+            __m256i R0a = _mm256_cvtepu8_epi16(r0a), R0b = _mm256_cvtepu8_epi16(r0b);
+            __m256i B1a = _mm256_cvtepu8_epi16(b1a), B1b = _mm256_cvtepu8_epi16(b1b);
+            __m256i G1a = _mm256_cvtepu8_epi16(g1a), G1b = _mm256_cvtepu8_epi16(g1b);
+            __m256i R1a = _mm256_cvtepu8_epi16(r1a), R1b = _mm256_cvtepu8_epi16(r1b);
+
+            // packus按128位通道交错，需要重排64位块
+            _mm256_storeu_si256((__m256i*)(y0 + x), _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(lumaAvx2(R0a, G0a, B0a), lumaAvx2(R0b, G0b, B0b)), 0xD8));
+            _mm256_storeu_si256((__m256i*)(y1 + x), _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(lumaAvx2(R1a, G1a, B1a), lumaAvx2(R1b, G1b, B1b)), 0xD8));
+
+            __m256i sb = _mm256_permute4x64_epi64(_mm256_hadd_epi16(_mm256_add_epi16(B0a, B1a), _mm256_add_epi16(B0b, B1b)), 0xD8);
+            __m256i sg = _mm256_permute4x64_epi64(_mm256_hadd_epi16(_mm256_add_epi16(G0a, G1a), _mm256_add_epi16(G0b, G1b)), 0xD8);
+            __m256i sr = _mm256_permute4x64_epi64(_mm256_hadd_epi16(_mm256_add_epi16(R0a, R1a), _mm256_add_epi16(R0b, R1b)), 0xD8);
+            __m256i ab = _mm256_srli_epi16(_mm256_add_epi16(sb, two), 2);
+            __m256i ag = _mm256_srli_epi16(_mm256_add_epi16(sg, two), 2);
+            __m256i ar = _mm256_srli_epi16(_mm256_add_epi16(sr, two), 2);
+
+            __m256i cu = _mm256_permute4x64_epi64(_mm256_packus_epi16(chromaAvx2(ar, ag, ab, -38, -74, 112), two), 0xD8);
+            __m256i cv = _mm256_permute4x64_epi64(_mm256_packus_epi16(chromaAvx2(ar, ag, ab, 112, -94, -18), two), 0xD8);
+            _mm_storeu_si128((__m128i*)(u + (x >> 1)), _mm256_castsi256_si128(cu));
+            _mm_storeu_si128((__m128i*)(v + (x >> 1)), _mm256_castsi256_si128(cv));
+        }
+        // 剩余不足32个像素的部分交给SSE4.1处理
+        return x + rowPairSse41(bgr0 + x * 3, bgr1 + x * 3, y0 + x, y1 + x, u + (x >> 1), v + (x >> 1), width - x);
+    }
+#endif //CC_HAVE_X86
+
+    typedef int (*RowPairFunc)(const unsigned char* bgr0, const unsigned char* bgr1,
+        unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int width);
+
+    struct ColorConvertDispatch
+    {
+        RowPairFunc rowPair = nullptr;// 为空时全部使用标量实现
+        const char* name = "scalar";
+
+        ColorConvertDispatch() {
+#ifdef CC_HAVE_X86
+#ifdef _MSC_VER
+            int info[4] = { 0 };
+            __cpuid(info, 0);
+            int maxLeaf = info[0];
+            __cpuid(info, 1);
+            bool sse41 = (info[2] & (1 << 19)) != 0;
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            bool avx2 = false;
+            if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            bool sse41 = __builtin_cpu_supports("sse4.1");
+            bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+            if (avx2) {
+                rowPair = rowPairAvx2;
+                name = "avx2";
+            }
+            else if (sse41) {
+                rowPair = rowPairSse41;
+                name = "sse4.1";
+            }
+#endif //CC_HAVE_X86
+        }
+    };
+    static const ColorConvertDispatch& getDispatch() {
+        static ColorConvertDispatch dispatch;
+        return dispatch;
+    }
+
+    void bgr24ToYuv420p(const unsigned char* bgr, int bgrStride, int width, int height,
+        unsigned char* dstY, int strideY,
+        unsigned char* dstU, int strideU,
+        unsigned char* dstV, int strideV) {
+
+        RowPairFunc rowPair = getDispatch().rowPair;
+
+        for (int j = 0; j < height; j += 2) {
+            int j1 = (j + 1 < height) ? j + 1 : j;
+            const unsigned char* bgr0 = bgr + (size_t)j * bgrStride;
+            const unsigned char* bgr1 = bgr + (size_t)j1 * bgrStride;
+            unsigned char* y0 = dstY + (size_t)j * strideY;
+            unsigned char* y1 = dstY + (size_t)j1 * strideY;
+            unsigned char* u = dstU + (size_t)(j >> 1) * strideU;
+            unsigned char* v = dstV + (size_t)(j >> 1) * strideV;
+
+            int x = 0;
+            if (rowPair) {
+                x = rowPair(bgr0, bgr1, y0, y1, u, v, width);
+            }
+            rowPairScalar(bgr0, bgr1, y0, y1, u, v, x, width);
+        }
+    }
+
+    void bgr24ToYuv420p(const unsigned char* bgr, int width, int height, unsigned char* yuvBuf) {
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        unsigned char* dstY = yuvBuf;
+        unsigned char* dstU = dstY + width * height;
+        unsigned char* dstV = dstU + chromaWidth * chromaHeight;
+
+        bgr24ToYuv420p(bgr, width * 3, width, height, dstY, width, dstU, chromaWidth, dstV, chromaWidth);
+    }
+
+    const char* getColorConvertImpl() {
+        return getDispatch().name;
+    }
+}
@@ -0,0 +1,27 @@
+﻿#ifndef ANALYZER_COLORCONVERT_H
+#define ANALYZER_COLORCONVERT_H
+#include <stdint.h>
+
+namespace AVSAnalyzer {
+
+    // bgr24转yuv420p，按2x2像素块计算色度平均值
+    // 运行时根据CPU选择AVX2/SSE4.1实现，不支持时使用标量实现
+    void bgr24ToYuv420p(const unsigned char* bgr, int bgrStride, int width, int height,
+        unsigned char* dstY, int strideY,
+        unsigned char* dstU, int strideU,
+        unsigned char* dstV, int strideV);
+
+    // yuvBuf为连续内存，布局与av_image_fill_arrays(AV_PIX_FMT_YUV420P, align=1)一致
+    void bgr24ToYuv420p(const unsigned char* bgr, int width, int height, unsigned char* yuvBuf);
+
+    // 单个bgr颜色转yuv，用于在yuv平面上绘制
+    static inline void bgrColorToYuv(int b, int g, int r, unsigned char& y, unsigned char& u, unsigned char& v) {
+        y = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    // 当前使用的实现：avx2/sse4.1/scalar
+    const char* getColorConvertImpl();
+}
+#endif //ANALYZER_COLORCONVERT_H
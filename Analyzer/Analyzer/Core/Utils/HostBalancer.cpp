@@ -0,0 +1,125 @@
+﻿#include "HostBalancer.h"
+#include "Common.h"
+#include "Log.h"
+
+namespace AVSAnalyzer {
+    HostBalancer::HostBalancer(const std::vector<std::string>& hosts, int ejectErrors, int ejectBaseMs, int ejectMaxMs) :
+        mEjectErrors(ejectErrors > 0 ? ejectErrors : 1),
+        mEjectBaseMs(ejectBaseMs),
+        mEjectMaxMs(ejectMaxMs)
+    {
+        for (int i = 0; i < hosts.size(); i++) {
+            HostStats stats;
+            stats.host = hosts[i];
+            mHosts.push_back(stats);
+        }
+        LOGI("hosts=%d,ejectErrors=%d,ejectBaseMs=%d,ejectMaxMs=%d", (int)hosts.size(), mEjectErrors, mEjectBaseMs, mEjectMaxMs);
+    }
+
+    HostBalancer::~HostBalancer()
+    {
+        LOGI("");
+    }
+
+    int HostBalancer::select(std::string& host) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        int size = mHosts.size();
+        if (size == 0) {
+            return -1;
+        }
+
+        int64_t now = getCurTime();
+        int index = -1;
+        float minScore = 0;
+        int ejectedIndex = -1;// 全部被摘除时，选择最早到期的地址
+
+        for (int n = 0; n < size; n++) {
+            int i = (mNext + n) % size;
+            HostStats& stats = mHosts[i];
+            if (stats.ejectUntil > now) {
+                if (ejectedIndex < 0 || stats.ejectUntil < mHosts[ejectedIndex].ejectUntil) {
+                    ejectedIndex = i;
+                }
+                continue;
+            }
+            float latency = stats.ewmaLatency > 1 ? stats.ewmaLatency : 1;
+            float score = (stats.outstanding + 1) * latency;
+            if (index < 0 || score < minScore) {
+                index = i;
+                minScore = score;
+            }
+        }
+        if (index < 0) {
+            index = ejectedIndex;
+        }
+        mNext = (index + 1) % size;
+
+        HostStats& stats = mHosts[index];
+        stats.outstanding++;
+        host = stats.host;
+        return index;
+    }
+
+    void HostBalancer::report(int index, bool success, int64_t latency) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        if (index < 0 || index >= mHosts.size()) {
+            return;
+        }
+        HostStats& stats = mHosts[index];
+        stats.outstanding--;
+        stats.requests++;
+
+        int bucket = 0;
+        while (bucket < HOST_LATENCY_BUCKET_NUM - 1 && latency > HOST_LATENCY_BUCKETS[bucket]) {
+            bucket++;
+        }
+        stats.latencyHistogram[bucket]++;
+
+        if (success) {
+            const float alpha = 0.2f;
+            if (stats.ewmaLatency <= 0) {
+                stats.ewmaLatency = latency;
+            }
+            else {
+                stats.ewmaLatency = alpha * latency + (1 - alpha) * stats.ewmaLatency;
+            }
+            stats.consecutiveErrors = 0;
+            stats.ejectCount = 0;
+            stats.healthy = true;
+        }
+        else {
+            stats.errors++;
+            stats.consecutiveErrors++;
+            int64_t now = getCurTime();
+            if (now < stats.ejectUntil) {
+                // 仍在摘除中，是摘除前发出的请求失败，不再延长摘除时长
+                return;
+            }
+            // 摘除到期后的探测请求失败时立即再次摘除
+            if (stats.consecutiveErrors >= mEjectErrors || stats.ejectCount > 0) {
+                // 摘除时长按连续摘除次数指数增长
+                int64_t ejectMs = mEjectBaseMs;
+                for (int i = 0; i < stats.ejectCount && ejectMs < mEjectMaxMs; i++) {
+                    ejectMs *= 2;
+                }
+                if (ejectMs > mEjectMaxMs) {
+                    ejectMs = mEjectMaxMs;
+                }
+                stats.ejectUntil = now + ejectMs;
+                stats.ejectCount++;
+                stats.consecutiveErrors = 0;
+                stats.healthy = false;
+                LOGE("eject host=%s,ejectMs=%lld,ejectCount=%d", stats.host.data(), ejectMs, stats.ejectCount);
+            }
+        }
+    }
+
+    void HostBalancer::getStats(std::vector<HostStats>& stats) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        int64_t now = getCurTime();
+        for (int i = 0; i < mHosts.size(); i++) {
+            stats.push_back(mHosts[i]);
+            stats.back().healthy = mHosts[i].ejectUntil <= now;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+﻿#ifndef ANALYZER_HOSTBALANCER_H
+#define ANALYZER_HOSTBALANCER_H
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace AVSAnalyzer {
+
+    // 请求耗时直方图的区间上限（毫秒），最后一个区间为大于最大上限的请求
+    static const int HOST_LATENCY_BUCKETS[] = { 10, 20, 50, 100, 200, 500, 1000, 2000 };
+    static const int HOST_LATENCY_BUCKET_NUM = sizeof(HOST_LATENCY_BUCKETS) / sizeof(HOST_LATENCY_BUCKETS[0]) + 1;
+
+    struct HostStats
+    {
+        std::string host;
+        bool    healthy = true;      // 未被摘除
+        int     outstanding = 0;     // 正在进行的请求数
+        float   ewmaLatency = 0;     // 请求耗时的指数加权平均值（毫秒）
+        int64_t requests = 0;        // 完成的请求数
+        int64_t errors = 0;          // 失败的请求数
+        int     consecutiveErrors = 0;// 连续失败的请求数
+        int     ejectCount = 0;      // 连续被摘除的次数，决定下次摘除的时长
+        int64_t ejectUntil = 0;      // 摘除结束的时间（毫秒），之前不再分配请求
+        int64_t latencyHistogram[HOST_LATENCY_BUCKET_NUM] = { 0 };
+    };
+
+    /*
+    在多个算法服务地址之间分配请求（线程安全）：
+    优先选择 (正在进行的请求数+1)*平均耗时 最小的地址；
+    连续失败达到阈值的地址被摘除一段时间，摘除时长按次数指数增长，到期后重新分配请求进行探测
+    */
+    class HostBalancer
+    {
+    public:
+        HostBalancer() = delete;
+        HostBalancer(const std::vector<std::string>& hosts, int ejectErrors, int ejectBaseMs, int ejectMaxMs);
+        ~HostBalancer();
+
+    public:
+        int  select(std::string& host);// 返回地址序号，没有可用地址时返回-1
+        void report(int index, bool success, int64_t latency);// 请求完成后必须调用
+        void getStats(std::vector<HostStats>& stats);
+
+    private:
+        std::vector<HostStats> mHosts;
+        std::mutex             mHosts_mtx;
+        int mEjectErrors;
+        int mEjectBaseMs;
+        int mEjectMaxMs;
+        int mNext = 0;// 得分相同时轮询
+    };
+}
+#endif //ANALYZER_HOSTBALANCER_H
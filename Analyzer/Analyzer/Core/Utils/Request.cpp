@@ -1,5 +1,7 @@
 ﻿#include "Request.h"
 #include <curl/curl.h>
+#include <string.h>
+#include "RequestPool.h"
 #include "Log.h"
 
 namespace AVSAnalyzer {
@@ -25,7 +27,7 @@ namespace AVSAnalyzer {
         return size * nmEmb;
     }
     */
-    Request::Request()
+    Request::Request(RequestPool* pool) :mPool(pool)
     {
 
 
@@ -35,9 +37,29 @@ namespace AVSAnalyzer {
     {
     }
 
+    void* Request::gainHandle(const char* url, std::string& host) {
+        if (mPool) {
+            host = RequestPool::parseHost(url);
+            return mPool->gain(host);
+        }
+        return curl_easy_init();
+    }
+    void Request::giveBackHandle(const std::string& host, void* curl, bool reusable) {
+        if (!curl) {
+            return;
+        }
+        if (mPool) {
+            mPool->giveBack(host, curl, reusable);
+        }
+        else {
+            curl_easy_cleanup((CURL*)curl);
+        }
+    }
+
     bool Request::get(const char* url, std::string& response) {
 
-        CURL* curl = curl_easy_init();
+        std::string host;
+        CURL* curl = (CURL*)gainHandle(url, host);
         bool result;
 
         if (curl) {
@@ -51,6 +73,7 @@ namespace AVSAnalyzer {
             curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&response);
             curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
 
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
             curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10);
             curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);
 
@@ -71,20 +94,35 @@ namespace AVSAnalyzer {
             LOGE("curl_easy_init error");
             result = false;
         }
-        curl_easy_cleanup(curl);
+        giveBackHandle(host, curl, result);
 
         return result;
     }
     bool Request::post(const char* url, const char* data, std::string& response) {
-        curl_global_init(CURL_GLOBAL_WIN32);
+        std::vector<std::string> headers;
+        headers.push_back("Content-Type:application/json;");
+        return this->postData(url, data, strlen(data), headers, response);
+    }
+    bool Request::postBinary(const char* url, const unsigned char* data, size_t size,
+        const std::vector<std::string>& headers, std::string& response) {
+        std::vector<std::string> allHeaders;
+        allHeaders.push_back("Content-Type:application/octet-stream");
+        allHeaders.insert(allHeaders.end(), headers.begin(), headers.end());
+        return this->postData(url, (const char*)data, size, allHeaders, response);
+    }
+    bool Request::postData(const char* url, const char* data, size_t size,
+        const std::vector<std::string>& extraHeaders, std::string& response) {
 
-        CURL* curl = curl_easy_init();
+        std::string host;
+        CURL* curl = (CURL*)gainHandle(url, host);
         bool result;
 
         if (curl) {
             struct curl_slist* headers = nullptr;
             headers = curl_slist_append(headers, "User-Agent: AnalyVideo;");
-            headers = curl_slist_append(headers, "Content-Type:application/json;");
+            for (int i = 0; i < extraHeaders.size(); i++) {
+                headers = curl_slist_append(headers, extraHeaders[i].data());
+            }
             headers = curl_slist_append(headers,
                 "expect: ;");// libcurl请求慢解决方法 https://blog.csdn.net/feng964497595/article/details/86316861
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
@@ -95,6 +133,7 @@ namespace AVSAnalyzer {
             curl_easy_setopt(curl, CURLOPT_URL, url);
             curl_easy_setopt(curl, CURLOPT_POST, 1); // post type
             curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data); // post params
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)size);
 
             curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, false); // if want to use https
             curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, false); // set peer and host verify false
@@ -105,6 +144,7 @@ namespace AVSAnalyzer {
             curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&response);
             curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
             // curl_easy_setopt(curl, CURLOPT_HEADER, false);// 是否显示响应头信息
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
             curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30);
             curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30);
 
@@ -126,8 +166,7 @@ namespace AVSAnalyzer {
             LOGE("curl_easy_init error: url=%s", url);
             result = false;
         }
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
+        giveBackHandle(host, curl, result);
         return result;
 
     }
@@ -17,17 +17,30 @@ https://blog.csdn.net/houxian1103/article/details/123343248
 
 */
 #include <string>
+#include <vector>
 namespace AVSAnalyzer {
+    class RequestPool;
+
     class Request
     {
     public:
-        Request();
+        // pool不为空时，从连接池获取curl句柄并复用连接；为空时每次请求新建连接
+        explicit Request(RequestPool* pool = nullptr);
         ~Request();
 
     public:
         bool get(const char* url, std::string& response);
         bool post(const char* url, const char* data, std::string& response);
-
+        // 直接上传二进制数据（application/octet-stream），headers为附加的请求头，如 "X-Algorithm: openvino_yolov5"
+        bool postBinary(const char* url, const unsigned char* data, size_t size,
+            const std::vector<std::string>& headers, std::string& response);
+
+    private:
+        bool postData(const char* url, const char* data, size_t size,
+            const std::vector<std::string>& extraHeaders, std::string& response);
+        void* gainHandle(const char* url, std::string& host);
+        void giveBackHandle(const std::string& host, void* curl, bool reusable);
+        RequestPool* mPool;
     };
 }
 #endif //ANALYZER_REQUEST_H
\ No newline at end of file
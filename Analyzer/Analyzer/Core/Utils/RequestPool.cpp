@@ -0,0 +1,129 @@
+﻿#include "RequestPool.h"
+#include <curl/curl.h>
+#include <chrono>
+#include "Log.h"
+
+namespace AVSAnalyzer {
+    RequestPool::RequestPool(int maxPerHost, int waitTimeoutMs) :
+        mMaxPerHost(maxPerHost > 0 ? maxPerHost : 1),
+        mWaitTimeoutMs(waitTimeoutMs)
+    {
+        LOGI("maxPerHost=%d,waitTimeoutMs=%d", mMaxPerHost, mWaitTimeoutMs);
+    }
+
+    RequestPool::~RequestPool()
+    {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        for (auto f = mHosts.begin(); f != mHosts.end(); ++f)
+        {
+            HostEntry* entry = f->second;
+            if (entry->stats.inUse > 0) {
+                LOGE("host=%s,inUse=%d, handles are still in use", f->first.data(), entry->stats.inUse);
+            }
+            for (auto curl : entry->idleHandles) {
+                curl_easy_cleanup((CURL*)curl);
+            }
+            entry->idleHandles.clear();
+            delete entry;
+        }
+        mHosts.clear();
+        LOGI("");
+    }
+
+    void RequestPool::globalInit() {
+        // curl_global_init不是线程安全的，只能在创建任何线程之前调用一次
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+    void RequestPool::globalCleanup() {
+        curl_global_cleanup();
+    }
+
+    std::string RequestPool::parseHost(const char* url) {
+        std::string str(url);
+        size_t begin = str.find("://");
+        begin = (begin == std::string::npos) ? 0 : begin + 3;
+        size_t end = str.find('/', begin);
+        if (end == std::string::npos) {
+            return str;
+        }
+        return str.substr(0, end);
+    }
+
+    void* RequestPool::gain(const std::string& host) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+
+        HostEntry* entry = nullptr;
+        auto f = mHosts.find(host);
+        if (f == mHosts.end()) {
+            entry = new HostEntry;
+            entry->stats.host = host;
+            mHosts[host] = entry;
+        }
+        else {
+            entry = f->second;
+        }
+
+        if (entry->idleHandles.empty() && entry->stats.inUse >= mMaxPerHost) {
+            entry->stats.waits++;
+            bool ok = mHosts_cv.wait_for(lck, std::chrono::milliseconds(mWaitTimeoutMs), [&] {
+                return !entry->idleHandles.empty() || entry->stats.inUse < mMaxPerHost;
+            });
+            if (!ok) {
+                entry->stats.timeouts++;
+                return nullptr;
+            }
+        }
+
+        CURL* curl = nullptr;
+        if (!entry->idleHandles.empty()) {
+            curl = (CURL*)entry->idleHandles.back();
+            entry->idleHandles.pop_back();
+            entry->stats.reused++;
+        }
+        else {
+            curl = curl_easy_init();
+            if (!curl) {
+                LOGE("curl_easy_init error: host=%s", host.data());
+                return nullptr;
+            }
+            entry->stats.created++;
+        }
+        entry->stats.inUse++;
+        entry->stats.idle = entry->idleHandles.size();
+
+        return curl;
+    }
+
+    void RequestPool::giveBack(const std::string& host, void* curl, bool reusable) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        auto f = mHosts.find(host);
+        if (f == mHosts.end()) {
+            curl_easy_cleanup((CURL*)curl);
+            return;
+        }
+        HostEntry* entry = f->second;
+        entry->stats.inUse--;
+        if (reusable) {
+            // 保留句柄中已经建立的连接，下次请求直接复用
+            curl_easy_reset((CURL*)curl);
+            entry->idleHandles.push_back(curl);
+        }
+        else {
+            // 请求失败时连接状态未知，直接释放
+            entry->stats.errors++;
+            curl_easy_cleanup((CURL*)curl);
+        }
+        entry->stats.idle = entry->idleHandles.size();
+        lck.unlock();
+
+        mHosts_cv.notify_all();
+    }
+
+    void RequestPool::getStats(std::vector<RequestPoolStats>& stats) {
+        std::unique_lock<std::mutex> lck(mHosts_mtx);
+        for (auto f = mHosts.begin(); f != mHosts.end(); ++f)
+        {
+            stats.push_back(f->second->stats);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+﻿#ifndef ANALYZER_REQUESTPOOL_H
+#define ANALYZER_REQUESTPOOL_H
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+namespace AVSAnalyzer {
+
+    // 同一个服务地址的curl句柄统计
+    struct RequestPoolStats
+    {
+        std::string host;
+        int     inUse = 0;      // 正在使用的句柄数
+        int     idle = 0;       // 空闲的句柄数
+        int64_t created = 0;    // 创建句柄次数
+        int64_t reused = 0;     // 复用句柄次数（复用已建立的连接）
+        int64_t waits = 0;      // 达到连接数上限后等待的次数
+        int64_t timeouts = 0;   // 等待超时的次数
+        int64_t errors = 0;     // 请求失败后丢弃句柄的次数
+    };
+
+    /*
+    按服务地址（scheme://host:port）缓存curl easy句柄，句柄复用时保留已建立的keep-alive连接，
+    避免每次请求都重新建立和断开TCP连接。同一地址同时使用的句柄数不超过maxPerHost
+    */
+    class RequestPool
+    {
+    public:
+        RequestPool() = delete;
+        RequestPool(int maxPerHost, int waitTimeoutMs);
+        ~RequestPool();
+
+    public:
+        static void globalInit();   // 进程启动时调用一次
+        static void globalCleanup();// 进程退出时调用一次
+        static std::string parseHost(const char* url);
+
+        void* gain(const std::string& host);// 返回CURL*，超时返回nullptr
+        void giveBack(const std::string& host, void* curl, bool reusable);
+        void getStats(std::vector<RequestPoolStats>& stats);
+
+    private:
+        struct HostEntry
+        {
+            std::vector<void*> idleHandles;
+            RequestPoolStats   stats;
+        };
+        int mMaxPerHost;
+        int mWaitTimeoutMs;
+        std::map<std::string, HostEntry*> mHosts;
+        std::mutex                        mHosts_mtx;
+        std::condition_variable           mHosts_cv;
+    };
+}
+#endif //ANALYZER_REQUESTPOOL_H
@@ -0,0 +1,68 @@
+﻿#ifndef ANALYZER_RINGBUFFER_H
+#define ANALYZER_RINGBUFFER_H
+#include <vector>
+
+namespace AVSAnalyzer {
+
+    // 固定容量的环形缓冲区，入队出队都是O(1)，不加锁，只能在一个线程中使用
+    template <typename T>
+    class RingBuffer
+    {
+    public:
+        explicit RingBuffer(int capacity = 0) {
+            reset(capacity);
+        }
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+    public:
+        // 重新分配容量并清空，元素由调用者在此之前取出并释放
+        void reset(int capacity) {
+            mBuf.assign(capacity > 0 ? capacity : 1, T());
+            mHead = 0;
+            mSize = 0;
+        }
+        int capacity() const {
+            return (int)mBuf.size();
+        }
+        int size() const {
+            return mSize;
+        }
+        bool empty() const {
+            return 0 == mSize;
+        }
+        bool full() const {
+            return mSize == (int)mBuf.size();
+        }
+        // 已满时返回false，不覆盖最旧的元素
+        bool push(const T& item) {
+            if (full()) {
+                return false;
+            }
+            mBuf[(mHead + mSize) % mBuf.size()] = item;
+            mSize++;
+            return true;
+        }
+        // 为空时返回false
+        bool pop(T& item) {
+            if (empty()) {
+                return false;
+            }
+            item = mBuf[mHead];
+            mBuf[mHead] = T();
+            mHead = (mHead + 1) % mBuf.size();
+            mSize--;
+            return true;
+        }
+        // index为0时是最旧的元素
+        T& at(int index) {
+            return mBuf[(mHead + index) % mBuf.size()];
+        }
+
+    private:
+        std::vector<T> mBuf;
+        int mHead = 0;// 最旧元素的位置
+        int mSize = 0;
+    };
+}
+#endif //ANALYZER_RINGBUFFER_H
@@ -0,0 +1,46 @@
+﻿#ifndef ANALYZER_VIDEOFRAME_H
+#define ANALYZER_VIDEOFRAME_H
+#include <stdint.h>
+#include <memory>
+namespace AVSAnalyzer {
+
+	struct VideoFrame
+	{
+	public:
+		enum VideoFrameType
+		{
+			BGR = 0,
+			YUV420P,
+
+		};
+		VideoFrame(VideoFrameType type, int size, int width, int height) {
+			this->type = type;
+			this->size = size;
+			this->width = width;
+			this->height = height;
+			this->data = new uint8_t[this->size];
+
+		}
+		~VideoFrame() {
+			delete[] this->data;
+			this->data = nullptr;
+		}
+		VideoFrame(const VideoFrame&) = delete;
+		VideoFrame& operator=(const VideoFrame&) = delete;
+
+		VideoFrameType type;
+		int size;
+		int width;
+		int height;
+		uint8_t* data;
+		bool happen = false;// 是否发生事件
+		float happenScore = 0;// 发生事件的分数
+
+
+	};
+
+	// 解码后的一帧在推流、报警等多个消费者之间共享，引用计数归零时释放
+	// 帧在分发给消费者之后只读，消费者不得修改data
+	typedef std::shared_ptr<VideoFrame> VideoFramePtr;
+}
+#endif //ANALYZER_VIDEOFRAME_H
@@ -0,0 +1,96 @@
+﻿#include "VideoFramePool.h"
+#include "Utils/Log.h"
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+namespace AVSAnalyzer {
+    VideoFramePool::VideoFramePool(VideoFrame::VideoFrameType type, int width, int height, int capacity) :
+        mType(type),
+        mWidth(width),
+        mHeight(height),
+        mCapacity(capacity)
+    {
+        AVPixelFormat pix_fmt = (VideoFrame::BGR == type) ? AV_PIX_FMT_BGR24 : AV_PIX_FMT_YUV420P;
+        mFrameSize = av_image_get_buffer_size(pix_fmt, width, height, 1);
+        mFreeFrames.reserve(capacity);
+
+        LOGI("type=%d,width=%d,height=%d,frameSize=%d,capacity=%d", type, width, height, mFrameSize, capacity);
+    }
+
+    VideoFramePool::~VideoFramePool()
+    {
+        mFreeFrames_mtx.lock();
+        if (mUsingCount > 0) {
+            LOGE("mUsingCount=%d, frames are still in use", mUsingCount);
+        }
+        for (auto frame : mFreeFrames) {
+            delete frame;
+        }
+        mFreeFrames.clear();
+        mFreeFrames_mtx.unlock();
+
+        LOGI("hits=%lld,misses=%lld,highWater=%d", mHits, mMisses, mHighWater);
+    }
+
+    VideoFramePtr VideoFramePool::gain() {
+        VideoFrame* frame = nullptr;
+        bool pooled = true;
+
+        mFreeFrames_mtx.lock();
+        if (!mFreeFrames.empty()) {
+            frame = mFreeFrames.back();
+            mFreeFrames.pop_back();
+            mHits++;
+        }
+        else {
+            mMisses++;
+            if (mAllocatedCount < mCapacity) {
+                mAllocatedCount++;
+            }
+            else {
+                pooled = false;// 超出容量，使用完直接释放
+            }
+        }
+        mUsingCount++;
+        if (mUsingCount > mHighWater) {
+            mHighWater = mUsingCount;
+        }
+        mFreeFrames_mtx.unlock();
+
+        if (!frame) {
+            frame = new VideoFrame(mType, mFrameSize, mWidth, mHeight);
+        }
+        frame->happen = false;
+        frame->happenScore = 0;
+
+        return VideoFramePtr(frame, [this, pooled](VideoFrame* f) {
+            this->giveBack(f, pooled);
+        });
+    }
+    int VideoFramePool::getFrameSize() {
+        return mFrameSize;
+    }
+    void VideoFramePool::getStats(int& capacity, int64_t& hits, int64_t& misses, int& highWater) {
+        mFreeFrames_mtx.lock();
+        capacity = mCapacity;
+        hits = mHits;
+        misses = mMisses;
+        highWater = mHighWater;
+        mFreeFrames_mtx.unlock();
+    }
+    void VideoFramePool::giveBack(VideoFrame* frame, bool pooled) {
+        mFreeFrames_mtx.lock();
+        mUsingCount--;
+        if (pooled) {
+            mFreeFrames.push_back(frame);
+            frame = nullptr;
+        }
+        mFreeFrames_mtx.unlock();
+
+        if (frame) {
+            delete frame;
+            frame = nullptr;
+        }
+    }
+}
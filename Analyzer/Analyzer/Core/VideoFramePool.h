@@ -0,0 +1,37 @@
+﻿#ifndef ANALYZER_VIDEOFRAMEPOOL_H
+#define ANALYZER_VIDEOFRAMEPOOL_H
+#include <vector>
+#include <mutex>
+#include "VideoFrame.h"
+namespace AVSAnalyzer {
+
+	// 固定容量的视频帧池，每个ControlExecutor持有一个，按视频流的宽高和像素格式分配帧
+	class VideoFramePool
+	{
+	public:
+		VideoFramePool(VideoFrame::VideoFrameType type, int width, int height, int capacity);
+		~VideoFramePool();
+	public:
+		VideoFramePtr gain();// 从池中获取一帧，引用计数归零时自动归还到池中
+
+		int getFrameSize();
+		void getStats(int& capacity, int64_t& hits, int64_t& misses, int& highWater);
+	private:
+		void giveBack(VideoFrame* frame, bool pooled);
+
+		VideoFrame::VideoFrameType mType;
+		int mWidth;
+		int mHeight;
+		int mFrameSize;
+		int mCapacity;
+
+		std::vector<VideoFrame*> mFreeFrames;// 空闲的帧
+		std::mutex               mFreeFrames_mtx;
+		int     mAllocatedCount = 0;// 池中已分配的帧数（空闲 + 使用中）
+		int     mUsingCount = 0;    // 正在使用的帧数（包含超出容量临时分配的帧）
+		int     mHighWater = 0;     // 同时使用帧数的最大值
+		int64_t mHits = 0;          // 从空闲帧中获取的次数
+		int64_t mMisses = 0;        // 需要新分配内存的次数
+	};
+}
+#endif //ANALYZER_VIDEOFRAMEPOOL_H